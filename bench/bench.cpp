@@ -0,0 +1,614 @@
+// Microbenchmarks of the force kernel, integrator step, Kepler solver, loaders
+// and picture drawing and saving. Every benchmark is calibrated to run for at
+// least --min-time per repetition, then repeated to report the mean, spread
+// and fastest time per operation. Results can be written as CSV or JSON and
+// compared against an earlier CSV run, failing when any benchmark regressed
+// by more than --threshold percent. --counters adds hardware event counts
+// per operation, where the kernel allows them.
+
+#include "../include/camera.h"
+#include "../include/catalog.h"
+#include "../include/counters.h"
+#include "../include/helpers.h"
+#include "../include/json.h"
+#include "../include/keplerianApprox.h"
+#include "../include/nBodyApprox.h"
+#include "../include/picture.h"
+#include "../include/planet.h"
+#include "../include/png.h"
+#include "../include/util.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+
+// keeps the compiler from discarding a result that is never used
+template <typename T> void keep(const T &value) {
+  asm volatile("" : : "r"(&value) : "memory");
+}
+
+
+// runs an operation the given number of times
+using Operation = std::function<void(size_t)>;
+
+struct Benchmark {
+  std::string name;
+
+  // builds the operation's data, untimed, and returns the operation
+  std::function<Operation()> prepare;
+
+  // items each operation processes, and what they are, for throughput
+  double itemsPerOp = 1.0;
+  std::string unit = "op";
+};
+
+
+struct Result {
+  std::string name;
+  size_t iterations = 0;
+  int repetitions = 0;
+  double meanNs = 0.0;
+  double stddevNs = 0.0;
+  double minNs = 0.0;
+  double throughput = 0.0; // items per second at the mean
+  std::string unit;
+
+  // events of every timed repetition together, with --counters
+  CounterValues events;
+  size_t countedOps = 0;
+};
+
+
+struct BenchOptions {
+  std::string filter;
+  int repetitions = 5;
+  double minTimeMs = 100.0;
+  std::string format = "text";
+  std::string outputFile;
+  std::string baselineFile;
+  double threshold = 10.0; // [%]
+  bool list = false;
+  bool isCounting = false;
+};
+
+
+// Bodies of planets.json at J2000, padded up to count bodies with small
+// bodies on circular orbits between 2 and 4 AU, the Sun last
+std::vector<StateVector> makeBodies(size_t count) {
+  std::vector<OrbitalElements> elements;
+  std::vector<StateVector> bodies;
+  populatePlanets(elements, bodies, "planets.json");
+  addSun(bodies);
+  populateStateVectors(bodies, "solutions.json");
+
+  const StateVector sun = bodies.back();
+  bodies.pop_back();
+
+  std::mt19937 rng(2000);
+  std::uniform_real_distribution<double> radius(2.0 * M_PER_AU,
+                                                4.0 * M_PER_AU);
+  std::uniform_real_distribution<double> angle(0.0, 2 * M_PI);
+  for (size_t k = 0; bodies.size() + 1 < count; k++) {
+    const double r = radius(rng);
+    const double theta = angle(rng);
+    const double v = std::sqrt(G * M_SUN / r);
+    bodies.push_back(
+        {internName("bench-" + std::to_string(k)),
+         Coord(r * std::cos(theta), r * std::sin(theta), 0.0),
+         Coord(-v * std::sin(theta), v * std::cos(theta), 0.0), 1e15});
+  }
+  bodies.push_back(sun);
+  return bodies;
+}
+
+
+std::vector<Benchmark> makeBenchmarks() {
+  std::vector<Benchmark> benchmarks;
+
+  benchmarks.push_back({"calcAcc",
+                        [] {
+                          const std::vector<StateVector> b = makeBodies(0);
+                          return [b](size_t n) {
+                            Coord acc1, acc2;
+                            for (size_t i = 0; i < n; i++) {
+                              calcAcc(b[0], b[1], acc1, acc2);
+                              keep(acc1);
+                            }
+                          };
+                        },
+                        1.0, "pair"});
+
+  for (const size_t count : {10, 100, 1000}) {
+    const std::string size = std::to_string(count);
+    benchmarks.push_back({"sumAcc/" + size,
+                          [count] {
+                            const std::vector<StateVector> b =
+                                makeBodies(count);
+                            return [b](size_t n) {
+                              for (size_t i = 0; i < n; i++) {
+                                const Coord acc = sumAcc(b[0], 0, b);
+                                keep(acc);
+                              }
+                            };
+                          },
+                          double(count - 1), "pair"});
+  }
+
+  for (const size_t count : {10, 100, 1000}) {
+    const std::string size = std::to_string(count);
+    benchmarks.push_back({"step/" + size,
+                          [count] {
+                            std::vector<StateVector> b = makeBodies(count);
+                            std::vector<StateVector> next = b;
+                            return [b, next](size_t n) mutable {
+                              for (size_t i = 0; i < n; i++) {
+                                step(b, next, SEC_PER_DAY / 4);
+                                b.swap(next);
+                              }
+                              keep(b[0].pos);
+                            };
+                          },
+                          double(count), "body"});
+  }
+
+  for (const double e : {0.0, 0.2, 0.5, 0.9, 0.99}) {
+    std::ostringstream name;
+    name << "calcEccentricAnomaly/e=" << e;
+    benchmarks.push_back({name.str(),
+                          [e] {
+                            return [e](size_t n) {
+                              // mean anomalies spread over the whole orbit
+                              double sum = 0.0;
+                              for (size_t i = 0; i < n; i++) {
+                                const double M = (i % 64) * (2 * M_PI / 64);
+                                sum += calcEccentricAnomaly(e, M);
+                              }
+                              keep(sum);
+                            };
+                          },
+                          1.0, "solve"});
+  }
+
+  benchmarks.push_back({"populatePlanets",
+                        [] {
+                          return [](size_t n) {
+                            for (size_t i = 0; i < n; i++) {
+                              std::vector<OrbitalElements> elements;
+                              std::vector<StateVector> bodies;
+                              populatePlanets(elements, bodies,
+                                              "planets.json");
+                              keep(bodies.back().mass);
+                            }
+                          };
+                        },
+                        1.0, "file"});
+
+  benchmarks.push_back({"populateStateVectors",
+                        [] {
+                          std::vector<StateVector> b = makeBodies(0);
+                          return [b](size_t n) mutable {
+                            for (size_t i = 0; i < n; i++) {
+                              populateStateVectors(b, "solutions.json");
+                              keep(b[0].pos);
+                            }
+                          };
+                        },
+                        1.0, "file"});
+
+  benchmarks.push_back({"populateSolutions",
+                        [] {
+                          std::vector<StateVector> b = makeBodies(0);
+                          return [b](size_t n) mutable {
+                            for (size_t i = 0; i < n; i++) {
+                              populateSolutions(b, 9132.0, "solutions.json");
+                              keep(b[0].pos);
+                            }
+                          };
+                        },
+                        1.0, "file"});
+
+  benchmarks.push_back(
+      {"Picture::set",
+       [] {
+         auto pic = std::make_shared<Picture>(2000, 2000, rgbColor{13, 5, 41});
+         return [pic](size_t n) {
+           std::mt19937 rng(1);
+           for (size_t i = 0; i < n; i++) {
+             const unsigned r = rng();
+             pic->set(r % 2000, (r >> 16) % 2000, {61, 23, 193});
+           }
+           keep(*pic);
+         };
+       },
+       1.0, "pixel"});
+
+  benchmarks.push_back(
+      {"drawBodies/1000",
+       [] {
+         const std::vector<StateVector> b = makeBodies(1000);
+         auto pic = std::make_shared<Picture>(2000, 2000, rgbColor{13, 5, 41});
+         pic->setFixed(true);
+         const Camera camera(2000, 35);
+         return [b, pic, camera](size_t n) {
+           for (size_t i = 0; i < n; i++) {
+             drawBodies(b, *pic, camera);
+           }
+           keep(*pic);
+         };
+       },
+       1000.0, "body"});
+
+  // a typical rendering: background, a few orbits and bodies
+  auto orbits = [] {
+    auto pic = std::make_shared<Picture>(1000, 1000, rgbColor{13, 5, 41});
+    pic->setFixed(true);
+    const Camera camera(1000, 35);
+    std::vector<StateVector> b = makeBodies(10);
+    std::vector<StateVector> next;
+    for (int i = 0; i < 4000; i++) {
+      drawBodies(b, *pic, camera);
+      step(b, next, SEC_PER_DAY);
+      b.swap(next);
+    }
+    return pic;
+  };
+  const std::string scratch =
+      (std::filesystem::temp_directory_path() / "celestial-bench.png")
+          .string();
+  const double pixels = 1000.0 * 1000.0;
+
+  benchmarks.push_back({"Picture::save/lodepng",
+                        [orbits, scratch] {
+                          auto pic = orbits();
+                          return [pic, scratch](size_t n) {
+                            for (size_t i = 0; i < n; i++) {
+                              pic->save(scratch);
+                            }
+                          };
+                        },
+                        pixels, "pixel"});
+
+  benchmarks.push_back({"Picture::save/fast",
+                        [orbits, scratch] {
+                          auto pic = orbits();
+                          return [pic, scratch](size_t n) {
+                            for (size_t i = 0; i < n; i++) {
+                              pic->save(scratch, PngOptions());
+                            }
+                          };
+                        },
+                        pixels, "pixel"});
+
+  return benchmarks;
+}
+
+
+// nanoseconds to run the operation n times
+double timeRun(const Operation &operation, size_t n) {
+  const auto start = std::chrono::steady_clock::now();
+  operation(n);
+  const auto end = std::chrono::steady_clock::now();
+  return std::chrono::duration<double, std::nano>(end - start).count();
+}
+
+
+// Calibrates the iteration count to fill minTimeMs, then times every
+// repetition
+Result measure(const Benchmark &benchmark, const BenchOptions &options) {
+  const Operation operation = benchmark.prepare();
+  const double minNs = options.minTimeMs * 1e6;
+  size_t n = 1;
+  double elapsed = timeRun(operation, n);
+  while (elapsed < minNs && n < (size_t(1) << 40)) {
+    const double scale = elapsed > 0 ? minNs / elapsed : 100.0;
+    n = std::max(n + 1, size_t(n * std::min(100.0, scale * 1.2)));
+    elapsed = timeRun(operation, n);
+  }
+
+  // read around each repetition, so calibration is not counted
+  Result result;
+  std::vector<double> samples;
+  for (int r = 0; r < options.repetitions; r++) {
+    const CounterValues start =
+        options.isCounting ? threadCounters().read() : CounterValues();
+    samples.push_back(timeRun(operation, n) / n);
+    if (options.isCounting)
+      result.events += threadCounters().read() - start;
+  }
+  if (options.isCounting)
+    result.countedOps = n * options.repetitions;
+
+  result.name = benchmark.name;
+  result.iterations = n;
+  result.repetitions = options.repetitions;
+  result.unit = benchmark.unit;
+  for (const double s : samples) {
+    result.meanNs += s;
+  }
+  result.meanNs /= samples.size();
+  for (const double s : samples) {
+    result.stddevNs += (s - result.meanNs) * (s - result.meanNs);
+  }
+  if (samples.size() > 1)
+    result.stddevNs = std::sqrt(result.stddevNs / (samples.size() - 1));
+  result.minNs = *std::min_element(samples.begin(), samples.end());
+  result.throughput = benchmark.itemsPerOp * 1e9 / result.meanNs;
+  return result;
+}
+
+
+// mean ns/op of every benchmark of a CSV written by this program
+std::map<std::string, double> readBaseline(const std::string &filename) {
+  std::ifstream fileStream(filename);
+  if (!fileStream)
+    throw std::runtime_error("Could not open " + filename + "\n");
+
+  std::map<std::string, double> baseline;
+  std::string line;
+  std::getline(fileStream, line); // header
+  while (std::getline(fileStream, line)) {
+    std::istringstream fields(line);
+    std::string name, iterations, repetitions, meanNs;
+    if (std::getline(fields, name, ',') &&
+        std::getline(fields, iterations, ',') &&
+        std::getline(fields, repetitions, ',') &&
+        std::getline(fields, meanNs, ','))
+      baseline[name] = std::stod(meanNs);
+  }
+  return baseline;
+}
+
+
+// events per operation, NaN when not counted
+double perOp(const Result &r, CounterEvent event) {
+  return r.countedOps > 0 && r.events.has(event)
+             ? double(r.events[event]) / r.countedOps
+             : std::nan("");
+}
+
+
+// cycles and instructions per op, IPC, and cache and branch miss percentages
+std::vector<double> counterColumns(const Result &r) {
+  return {perOp(r, CounterEvent::Cycles), perOp(r, CounterEvent::Instructions),
+          counterRatio(r.events, CounterEvent::Instructions,
+                       CounterEvent::Cycles),
+          100 * counterRatio(r.events, CounterEvent::CacheMisses,
+                             CounterEvent::CacheReferences),
+          100 * counterRatio(r.events, CounterEvent::BranchMisses,
+                             CounterEvent::Branches)};
+}
+
+const char *const kCounterColumns[] = {"cycles_per_op", "instructions_per_op",
+                                       "ipc", "cache_miss_pct",
+                                       "branch_miss_pct"};
+
+
+// counter columns are appended with --counters, empty where not counted
+void writeCSV(std::ostream &out, const std::vector<Result> &results,
+              bool isCounting) {
+  out << "name,iterations,repetitions,ns_per_op,stddev_ns,min_ns,throughput,"
+         "unit";
+  if (isCounting) {
+    for (const char *column : kCounterColumns) {
+      out << ',' << column;
+    }
+  }
+  out << '\n';
+  for (const Result &r : results) {
+    out << r.name << ',' << r.iterations << ',' << r.repetitions << ','
+        << r.meanNs << ',' << r.stddevNs << ',' << r.minNs << ','
+        << r.throughput << ',' << r.unit;
+    if (isCounting) {
+      for (const double value : counterColumns(r)) {
+        out << ',';
+        if (!std::isnan(value))
+          out << value;
+      }
+    }
+    out << '\n';
+  }
+}
+
+
+// counter fields are added with --counters, null where not counted
+void writeJSON(std::ostream &out, const std::vector<Result> &results,
+               bool isCounting) {
+  out << "[\n";
+  for (size_t i = 0; i < results.size(); i++) {
+    const Result &r = results[i];
+    out << "  {\"name\": \"" << r.name << "\", \"iterations\": "
+        << r.iterations << ", \"repetitions\": " << r.repetitions
+        << ", \"ns_per_op\": " << r.meanNs << ", \"stddev_ns\": "
+        << r.stddevNs << ", \"min_ns\": " << r.minNs
+        << ", \"throughput\": " << r.throughput << ", \"unit\": \"" << r.unit
+        << '"';
+    if (isCounting) {
+      const std::vector<double> values = counterColumns(r);
+      for (size_t c = 0; c < values.size(); c++) {
+        out << ", \"" << kCounterColumns[c] << "\": ";
+        if (std::isnan(values[c]))
+          out << "null";
+        else
+          out << values[c];
+      }
+    }
+    out << '}' << (i + 1 < results.size() ? "," : "") << '\n';
+  }
+  out << "]\n";
+}
+
+
+// one line per result as it finishes, with the change from the baseline
+void printResult(const Result &r, const std::map<std::string, double> &baseline,
+                 double threshold, bool &hasRegression) {
+  std::ostringstream throughput;
+  throughput << std::setprecision(3) << r.throughput << ' ' << r.unit << "/s";
+
+  std::cerr << std::left << std::setw(32) << r.name << std::right
+            << std::fixed << std::setprecision(1) << std::setw(14) << r.meanNs
+            << " ns/op  +-" << std::setw(5)
+            << 100.0 * r.stddevNs / r.meanNs << "%  min " << std::setw(14)
+            << r.minNs << "  " << std::setw(16) << throughput.str();
+
+  const auto found = baseline.find(r.name);
+  if (found != baseline.end()) {
+    const double change = 100.0 * (r.meanNs - found->second) / found->second;
+    std::cerr << "  " << std::showpos << change << std::noshowpos << '%';
+    if (change > threshold) {
+      std::cerr << " REGRESSION";
+      hasRegression = true;
+    }
+  }
+  std::cerr << std::defaultfloat << '\n';
+
+  if (r.countedOps == 0)
+    return;
+
+  // what was counted of cycles, instructions and misses, per op
+  const std::vector<double> values = counterColumns(r);
+  const char *labels[] = {" cycles", " instr", " IPC", "% cache miss",
+                          "% branch miss"};
+  std::ostringstream line;
+  line << std::fixed;
+  for (size_t c = 0; c < values.size(); c++) {
+    if (!std::isnan(values[c]))
+      line << "  " << std::setprecision(c < 2 ? 0 : 2) << values[c]
+           << labels[c];
+  }
+  if (r.events.has(CounterEvent::TaskClock))
+    line << "  " << std::setprecision(1)
+         << double(r.events[CounterEvent::TaskClock]) / r.countedOps
+         << " ns task";
+  std::cerr << "  " << line.str() << '\n';
+}
+
+
+void printBenchUsage(const std::string &program) {
+  std::cout
+      << "Usage: " << program << " [options]\n\n"
+      << "Run from the repository root, which holds the data files.\n\n"
+      << "      --filter TEXT        only benchmarks whose name contains TEXT\n"
+      << "      --repetitions N      timed repetitions (default 5)\n"
+      << "      --min-time MS        time per repetition (default 100)\n"
+      << "      --format text|csv|json  results on stdout or --output\n"
+      << "  -o, --output FILE        write results to FILE\n"
+      << "      --baseline FILE      compare with a CSV of an earlier run\n"
+      << "      --threshold PCT      slowdown failing the comparison\n"
+      << "                           (default 10)\n"
+      << "      --counters           count cycles, instructions, cache and\n"
+      << "                           branch misses per op where available\n"
+      << "      --list               print benchmark names and exit\n"
+      << "  -h, --help               display this message\n";
+}
+
+
+BenchOptions parseBenchArgs(int argc, char *argv[]) {
+  BenchOptions options;
+  for (int i = 1; i < argc; i++) {
+    const std::string arg = argv[i];
+    auto next = [&]() -> std::string {
+      if (i + 1 >= argc)
+        throw std::invalid_argument(arg + " requires a value");
+      return argv[++i];
+    };
+
+    if (arg == "-h" || arg == "--help") {
+      printBenchUsage(argv[0]);
+      std::exit(0);
+    } else if (arg == "--filter") {
+      options.filter = next();
+    } else if (arg == "--repetitions") {
+      options.repetitions = std::stoi(next());
+      if (options.repetitions < 1)
+        throw std::invalid_argument("--repetitions must be at least 1");
+    } else if (arg == "--min-time") {
+      options.minTimeMs = std::stod(next());
+    } else if (arg == "--format") {
+      options.format = next();
+      if (options.format != "text" && options.format != "csv" &&
+          options.format != "json")
+        throw std::invalid_argument("Unknown format \"" + options.format +
+                                    "\"");
+    } else if (arg == "-o" || arg == "--output") {
+      options.outputFile = next();
+    } else if (arg == "--baseline") {
+      options.baselineFile = next();
+    } else if (arg == "--threshold") {
+      options.threshold = std::stod(next());
+    } else if (arg == "--list") {
+      options.list = true;
+    } else if (arg == "--counters") {
+      options.isCounting = true;
+    } else {
+      throw std::invalid_argument("Unknown argument \"" + arg + "\"");
+    }
+  }
+  return options;
+}
+
+
+int main(int argc, char *argv[]) {
+  BenchOptions options;
+  try {
+    options = parseBenchArgs(argc, argv);
+  } catch (const std::exception &e) {
+    std::cerr << e.what() << "\n\n";
+    printBenchUsage(argv[0]);
+    return 1;
+  }
+
+  try {
+    const std::map<std::string, double> baseline =
+        options.baselineFile.empty() ? std::map<std::string, double>()
+                                     : readBaseline(options.baselineFile);
+
+    if (options.isCounting && !threadCounters().error().empty())
+      std::cerr << "counters: " << threadCounters().error() << "\n\n";
+
+    std::vector<Result> results;
+    bool hasRegression = false;
+    for (const Benchmark &benchmark : makeBenchmarks()) {
+      if (benchmark.name.find(options.filter) == std::string::npos)
+        continue;
+      if (options.list) {
+        std::cout << benchmark.name << '\n';
+        continue;
+      }
+      results.push_back(measure(benchmark, options));
+      printResult(results.back(), baseline, options.threshold, hasRegression);
+    }
+
+    std::ofstream fileStream;
+    if (!options.outputFile.empty()) {
+      fileStream.open(options.outputFile);
+      if (!fileStream)
+        throw std::runtime_error("Could not open " + options.outputFile +
+                                 "\n");
+    }
+    std::ostream &out = options.outputFile.empty() ? std::cout : fileStream;
+    if (options.format == "csv")
+      writeCSV(out, results, options.isCounting);
+    else if (options.format == "json")
+      writeJSON(out, results, options.isCounting);
+
+    return hasRegression ? 2 : 0;
+  } catch (const std::exception &e) {
+    std::cerr << e.what() << '\n';
+    return 1;
+  }
+}
@@ -0,0 +1,138 @@
+#ifndef ANIMATION_H
+#define ANIMATION_H
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "camera.h"
+#include "catalog.h"
+#include "picture.h"
+#include "planet.h"
+#include "png.h"
+#include "threadPool.h"
+
+// what submitting to a full frame queue does
+enum class Backpressure { Block, Drop };
+
+// returns the policy with the given name, throws std::invalid_argument if
+// none
+Backpressure parseBackpressure(const std::string &name);
+
+struct AnimationOptions {
+  // frames are written as <prefix>NNNNN.png, numbered by snapshot, unless
+  // rawFile is given
+  std::string prefix;
+
+  // every frame written as 8-bit RGB rows to one file, in frame number
+  // order, when not empty
+  std::string rawFile;
+
+  // snapshots waiting to be rendered before policy applies
+  size_t queueCapacity = 8;
+  Backpressure policy = Backpressure::Block;
+
+  // frames encoded at once, raw streams always use one writer
+  unsigned encoderThreads = 1;
+
+  bool isIndexed = false;
+  bool isFastPng = false;
+  PngOptions png;
+};
+
+// Turns snapshots into animation frames while the model keeps computing.
+// Submitting only copies the bodies into a bounded queue. One render thread
+// draws each queued snapshot into a picture recycled from a small pool, and a
+// pool of encoders writes the pictures out and returns them. A slow encoder
+// fills the picture pool, then the queue, then either blocks the submitting
+// threads or drops their frames
+class FramePipeline {
+public:
+  /**
+     Opens the raw stream, if any, and starts the render and encoder threads.
+     @param options output, queue and encoding settings
+     @param camera projects bodies onto every frame, sized as its canvas
+     @param background color of every frame before drawing
+     @param catalog body colors, white for bodies missing from it or when
+     null
+  */
+  FramePipeline(const AnimationOptions &options, const Camera &camera,
+                rgbColor background, const Catalog *catalog = nullptr);
+
+  /**
+     Finishes every queued frame, ignoring write errors.
+  */
+  ~FramePipeline();
+
+  FramePipeline(const FramePipeline &) = delete;
+  FramePipeline &operator=(const FramePipeline &) = delete;
+
+  /**
+     Queues a snapshot as a frame. Safe to call from several threads at once.
+     @param frame the frame number
+     @param bodies the bodies to draw
+     @return false if the queue was full and the frame was dropped
+  */
+  bool submit(size_t frame, const std::vector<StateVector> &bodies);
+
+  /**
+     Waits until every queued frame is written. Throws std::runtime_error if
+     any frame could not be written.
+  */
+  void finish();
+
+  size_t written() const { return _written; }
+  size_t dropped() const { return _dropped; }
+
+private:
+  struct Frame {
+    size_t number;
+    std::vector<StateVector> bodies;
+  };
+
+  void render();
+  void encode(size_t number, Picture *pic);
+  void writeRaw(size_t number, const Picture &pic);
+
+  const AnimationOptions _options;
+  const Camera _camera;
+  const Catalog *_catalog;
+
+  // every frame starts as a copy of this
+  Picture _blank;
+
+  std::deque<Frame> _queue;
+  std::vector<std::vector<StateVector>> _spareBodies;
+  std::vector<std::unique_ptr<Picture>> _pictures;
+  std::vector<Picture *> _freePictures;
+  bool _isClosed = false;
+  std::mutex _mutex;
+  std::condition_variable _queueChanged;
+  std::condition_variable _pictureFreed;
+
+  std::ofstream _raw;
+
+  // one raw frame converted to RGB rows, only touched by the single raw
+  // writer
+  std::vector<unsigned char> _rawBytes;
+
+  // numbers of frames dropped by submit, written blank when finishing
+  std::set<size_t> _droppedNumbers;
+
+  std::exception_ptr _error;
+  std::atomic<size_t> _written{0};
+  std::atomic<size_t> _dropped{0};
+
+  ThreadPool _encoders;
+  std::thread _renderer;
+};
+
+#endif
@@ -0,0 +1,101 @@
+#ifndef CAMERA_H
+#define CAMERA_H
+
+#include <string>
+
+#include "coord.h"
+#include "picture.h"
+#include "vec.h"
+
+enum class Projection { Orthographic, Oblique };
+
+// returns the projection with the given name, throws std::invalid_argument if
+// none
+Projection parseProjection(const std::string &name);
+
+// Where the camera looks from. The default looks straight down on the
+// ecliptic, centered on the Sun
+struct View {
+  // heliocentric position shown at the middle of the canvas [m]
+  Coord center;
+
+  // magnification of the whole-system view
+  double zoom = 1.0;
+
+  // counterclockwise turn of the picture about its middle [rad]
+  double rotation = 0.0;
+
+  // Orthographic views the ecliptic tilted by angle about the horizontal
+  // axis, Oblique draws heights half scale along angle from the horizontal
+  Projection projection = Projection::Orthographic;
+  double angle = 0.0; // [rad]
+};
+
+// Projects heliocentric positions onto a square canvas. At zoom 1 the canvas
+// shows halfWidth AU each side of the view's center. Pixels are given
+// relative to a window of the canvas, the whole canvas by default, so one
+// canvas can be drawn as several smaller tiles. Positions outside the window
+// are culled before they are converted to pixels
+class Camera {
+public:
+  /**
+     @param size width and height of the canvas
+     @param halfWidth AU shown each side of the center at zoom 1
+     @param view center, zoom, rotation and projection
+  */
+  Camera(int size, double halfWidth, const View &view = {});
+
+  /**
+     Restricts pixels to a rectangle of the canvas.
+     @param x the canvas column of the window's left edge
+     @param y the canvas row of the window's top edge
+     @param width the width of the window
+     @param height the height of the window
+  */
+  void setWindow(int x, int y, int width, int height);
+
+  /**
+     Projects a position to a pixel of the window.
+     @param pos the heliocentric position [m]
+     @param pixel receives the pixel relative to the window's top left
+     @param margin pixels beyond the window's edges still accepted
+     @return false if the position is culled, leaving pixel unset
+  */
+  bool project(const Coord &pos, Point &pixel, int margin = 0) const;
+
+  /**
+     Projects a position to continuous window coordinates, in which pixel
+     (x, y) covers [x, x + 1) x [y, y + 1).
+     @param pos the heliocentric position [m]
+     @param x receives the column coordinate
+     @param y receives the row coordinate
+     @param margin pixels beyond the window's edges still accepted
+     @return false if the position is culled
+  */
+  bool project(const Coord &pos, double &x, double &y, int margin = 0) const;
+
+  int size() const { return _size; }
+  int windowX() const { return _windowX; }
+  int windowY() const { return _windowY; }
+  int windowWidth() const { return _windowWidth; }
+  int windowHeight() const { return _windowHeight; }
+
+private:
+  void toCanvas(const Coord &pos, double &px, double &py) const;
+  bool isCulled(double px, double py, int margin) const;
+
+  int _size;
+  int _halfSize;
+  double _halfWidth;
+  View _view;
+
+  // the projection onto the picture plane, then the turn about its middle.
+  // The first two rows give the picture plane [AU], the third depth
+  Mat3d _transform;
+  int _windowX = 0;
+  int _windowY = 0;
+  int _windowWidth;
+  int _windowHeight;
+};
+
+#endif
@@ -0,0 +1,68 @@
+#ifndef CATALOG_H
+#define CATALOG_H
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "picture.h"
+#include "planet.h"
+
+enum class BodyClass { Star, Planet, DwarfPlanet, Moon, Asteroid, Comet };
+
+// properties of a body that the integrators never need
+struct BodyInfo {
+  BodyClass type = BodyClass::Planet;
+  rgbColor color;
+  double radius = 0.0; // [m]
+};
+
+// Metadata of every loaded body in a table indexed by body id. Independent of
+// the order of any state vector list, so bodies may be reordered or removed
+// freely
+class Catalog {
+public:
+  // sets the info of body id, replacing any it had
+  void add(BodyId id, const BodyInfo &info);
+
+  // info of body id, or null if there is none
+  const BodyInfo *find(BodyId id) const;
+
+  // info of the named body, or null if there is none
+  const BodyInfo *find(const std::string &name) const;
+
+  // color of body id, white if there is none
+  rgbColor colorOf(BodyId id) const {
+    return id < _isKnown.size() && _isKnown[id] ? _info[id].color
+                                                : rgbColor();
+  }
+
+  size_t size() const { return _size; }
+
+private:
+  std::vector<BodyInfo> _info;
+  std::vector<bool> _isKnown;
+  size_t _size = 0;
+};
+
+// returns the class with the given name, throws std::invalid_argument if none
+BodyClass parseBodyClass(const std::string &name);
+
+// color used for bodies of a class that do not set one
+rgbColor defaultColor(BodyClass type);
+
+// parses a #rrggbb color, throws std::invalid_argument if malformed
+rgbColor parseColor(const std::string &hex);
+
+// index of every body by id
+std::unordered_map<BodyId, size_t>
+indexById(const std::vector<StateVector> &bodies);
+
+// index of the most massive body
+size_t centralIndex(const std::vector<StateVector> &bodies);
+
+// appends the Sun at the origin to bodies, and its info to catalog when not
+// null
+void addSun(std::vector<StateVector> &bodies, Catalog *catalog = nullptr);
+
+#endif
@@ -0,0 +1,95 @@
+#ifndef CLI_H
+#define CLI_H
+
+#include <string>
+#include <vector>
+
+#include "animation.h"
+#include "camera.h"
+#include "density.h"
+#include "frame.h"
+#include "io.h"
+#include "nBodyApprox.h"
+#include "png.h"
+
+enum class Mode { Keplerian, NBody };
+
+struct Options {
+  Mode mode = Mode::NBody;
+  Format format = Format::Text;
+
+  // frame of the printed vectors only, integration stays barycentric
+  Frame frame = Frame::Heliocentric;
+
+  // days since J2000 epoch of every requested query, empty if none were given
+  std::vector<double> dates;
+
+  std::string planetsFile = "planets.json";
+  std::string solutionsFile = "solutions.json";
+  std::string outputFile = "result.png";
+
+  // answer queries from stdin or a Unix socket instead of running once
+  bool serve = false;
+  std::string socketPath;
+  double checkpointDays = 30.0;
+
+  // N-body invariants time series, written when the file name is not empty
+  std::string diagnosticsFile;
+  int diagnosticsInterval = 4;
+
+  IntegratorOptions integrator;
+
+  unsigned threads = 1;
+  bool render = true;
+
+  // width and height of the picture and of animation frames
+  int pictureSize = 2000;
+
+  // center, zoom, rotation and projection of the picture and frames
+  View view;
+
+  // rows drawn and encoded at a time, so pictures too large to hold can be
+  // rendered, 0 draws the whole picture at once
+  int tileRows = 0;
+
+  // draw paths as tone mapped density instead of overwriting pixels
+  bool isDensity = false;
+  ToneMap toneMap = ToneMap::Log;
+  double gamma = 2.2;
+
+  // draw paths as anti-aliased segments between samples this many pixels
+  // apart, 0 draws one pixel per body per step
+  double trailSpacing = 0.0;
+
+  // draw at this many times the size, then average down to anti-alias
+  int supersample = 1;
+
+  // draw into palette indices and save a paletted PNG
+  bool isIndexed = false;
+
+  // save with the fast parallel encoder instead of lodepng's defaults
+  bool isFastPng = false;
+  PngOptions png;
+
+  // one frame per snapshot, written while the model runs, when a frame
+  // prefix or raw video file is given
+  AnimationOptions animation;
+
+  // Chrome trace of the profiled scopes, written at the end when not empty.
+  // Needs a build with profiling compiled in
+  std::string traceFile;
+
+  // count hardware events of the profiled phases, with the same build
+  bool isCounting = false;
+
+  bool test = false;
+  bool help = false;
+};
+
+// parses command line arguments, throws std::invalid_argument on bad input
+Options parseArgs(int argc, char *argv[]);
+
+// displays accepted command line arguments
+void printUsage(const std::string &program);
+
+#endif
@@ -0,0 +1,58 @@
+#ifndef COLLISION_H
+#define COLLISION_H
+
+#include <utility>
+#include <vector>
+
+#include "nBodyApprox.h"
+#include "planet.h"
+#include "spatialHash.h"
+
+// Merges bodies whose (scaled) radii overlap and removes bodies that travel
+// beyond a cutoff distance from the central body, the most massive one.
+// Mergers are perfect: mass and momentum are conserved, the merged body sits
+// at the pair's centre of mass and keeps the heavier body's name, and volumes
+// add. Removed bodies are swap-removed, so the catalog shrinks in place
+// without reallocating and later steps cost less. Holds scratch space, so use
+// one per integrating thread
+class CollisionSolver {
+public:
+  /**
+     @param radiusScale factor applied to every body's radius, zero disables
+     mergers
+     @param ejectionDistance distance from the central body beyond which
+     bodies are removed [m], zero disables ejection
+  */
+  CollisionSolver(double radiusScale, double ejectionDistance);
+
+  // Merges and ejects bodies, removing the same entries from compensation
+  // when it is not null. Returns whether any body was removed
+  bool apply(std::vector<StateVector> &bodies,
+             std::vector<Compensation> *compensation = nullptr);
+
+  size_t mergerCount() const { return _mergerCount; }
+  size_t ejectionCount() const { return _ejectionCount; }
+
+private:
+  void merge(StateVector &survivor, const StateVector &absorbed) const;
+
+  const double _radiusScale;
+  const double _ejectionDistance;
+  size_t _mergerCount = 0;
+  size_t _ejectionCount = 0;
+
+  SpatialHash _hash;
+  std::vector<std::pair<size_t, size_t>> _pairs;
+  std::vector<bool> _isRemoved;
+};
+
+// Removes element k of values in constant time by moving the last element
+// into its place
+template <typename T> void swapRemove(std::vector<T> &values, size_t k) {
+  const size_t last = values.size() - 1;
+  if (k != last)
+    values[k] = std::move(values[last]);
+  values.pop_back();
+}
+
+#endif
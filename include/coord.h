@@ -1,24 +1,102 @@
 #ifndef COORD_H
 #define COORD_H
 
+#include <cmath>
+#include <iomanip>
+#include <iostream>
+
+// Cartesian vector of the physics [m, m/s or m/s/s]. Every operation is
+// inline, so chains like the Runge-Kutta combinations compile to plain
+// component arithmetic without calls or temporaries
 struct Coord {
 
-  Coord();
-  Coord(double x, double y, double z);
+  constexpr Coord() : x(0), y(0), z(0) {}
+  constexpr Coord(double x, double y, double z) : x(x), y(y), z(z) {}
+
+  // squared distance to other
+  constexpr double magSquared(const Coord &other) const {
+    const double xD = other.x - x;
+    const double yD = other.y - y;
+    const double zD = other.z - z;
+    return xD * xD + yD * yD + zD * zD;
+  }
+
+  void print() const {
+    std::cout << std::left << std::fixed << std::setprecision(9)
+              << "X: " << std::setw(14) << x << "Y: " << std::setw(14) << y
+              << "Z: " << std::setw(14) << z << '\n'
+              << std::right;
+  }
+
+  constexpr Coord operator+(const Coord &other) const {
+    return {x + other.x, y + other.y, z + other.z};
+  }
+
+  constexpr Coord operator-(const Coord &other) const {
+    return {x - other.x, y - other.y, z - other.z};
+  }
+
+  constexpr Coord operator*(const double scalar) const {
+    return {x * scalar, y * scalar, z * scalar};
+  }
+
+  constexpr Coord operator*(const Coord &other) const {
+    return {x * other.x, y * other.y, z * other.z};
+  }
+
+  constexpr Coord operator/(const Coord &other) const {
+    return {x / other.x, y / other.y, z / other.z};
+  }
 
-  double magSquared(const Coord &other) const;
-  void print() const;
+  constexpr Coord operator/(double scalar) const {
+    scalar = 1.0 / scalar;
+    return {x * scalar, y * scalar, z * scalar};
+  }
 
-  Coord operator+(const Coord &other) const;
-  Coord operator*(const double scalar) const;
-  Coord operator*(const Coord &other) const;
-  Coord operator/(double scalar) const;
-  Coord &operator+=(const Coord &other);
-  Coord &operator-=(const Coord &other);
-  Coord operator-(const Coord &other) const;
-  Coord operator/(const Coord &other) const;
+  constexpr Coord &operator+=(const Coord &other) {
+    x += other.x;
+    y += other.y;
+    z += other.z;
+    return *this;
+  }
+
+  constexpr Coord &operator-=(const Coord &other) {
+    x -= other.x;
+    y -= other.y;
+    z -= other.z;
+    return *this;
+  }
+
+  // this += v * scalar, without forming v * scalar
+  constexpr Coord &addScaled(const Coord &v, double scalar) {
+    x += v.x * scalar;
+    y += v.y * scalar;
+    z += v.z * scalar;
+    return *this;
+  }
+
+  // this -= v * scalar, without forming v * scalar
+  constexpr Coord &subScaled(const Coord &v, double scalar) {
+    x -= v.x * scalar;
+    y -= v.y * scalar;
+    z -= v.z * scalar;
+    return *this;
+  }
 
   double x, y, z;
 };
 
+constexpr double dot(const Coord &a, const Coord &b) {
+  return a.x * b.x + a.y * b.y + a.z * b.z;
+}
+
+constexpr double normSquared(const Coord &v) { return dot(v, v); }
+
+inline double norm(const Coord &v) { return std::sqrt(normSquared(v)); }
+
+// a * scale + b, the fused step of axpy-style updates
+constexpr Coord scaleAdd(const Coord &a, double scale, const Coord &b) {
+  return {a.x * scale + b.x, a.y * scale + b.y, a.z * scale + b.z};
+}
+
 #endif
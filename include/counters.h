@@ -0,0 +1,78 @@
+#ifndef COUNTERS_H
+#define COUNTERS_H
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// events a CounterGroup tries to count
+enum class CounterEvent {
+  Cycles,
+  Instructions,
+  CacheReferences,
+  CacheMisses,
+  Branches,
+  BranchMisses,
+  TaskClock, // [ns]
+  PageFaults
+};
+
+const size_t kCounterEvents = 8;
+
+// short name of an event for reports
+const char *counterName(CounterEvent event);
+
+// counts of every event, those the group could not open stay 0
+struct CounterValues {
+  std::array<uint64_t, kCounterEvents> counts{};
+  std::array<bool, kCounterEvents> isCounted{};
+
+  uint64_t operator[](CounterEvent event) const {
+    return counts[size_t(event)];
+  }
+  bool has(CounterEvent event) const { return isCounted[size_t(event)]; }
+
+  CounterValues &operator+=(const CounterValues &other);
+  CounterValues operator-(const CounterValues &start) const;
+};
+
+// numerator / denominator, NaN unless both are counted and the denominator
+// is not 0
+double counterRatio(const CounterValues &values, CounterEvent numerator,
+                    CounterEvent denominator);
+
+// Hardware and software event counters of the thread that opens them, in one
+// perf_event_open group so every event covers exactly the same instructions.
+// Only user-space events are counted. Each event is opened on its own, so
+// where hardware counters are missing, as in most virtual machines, or
+// forbidden by perf_event_paranoid, the software events still count. When
+// nothing can be opened the group is unavailable and reads zeros
+class CounterGroup {
+public:
+  CounterGroup();
+  ~CounterGroup();
+
+  CounterGroup(const CounterGroup &) = delete;
+  CounterGroup &operator=(const CounterGroup &) = delete;
+
+  // true when at least one event is counted
+  bool isAvailable() const { return _leader >= 0; }
+
+  // the events that could not be opened and why, empty if none
+  const std::string &error() const { return _error; }
+
+  // counts since the group was opened, scaled up for the time the kernel had
+  // to multiplex them off the hardware
+  CounterValues read() const;
+
+private:
+  int _leader = -1;
+  std::array<int, kCounterEvents> _fds;
+  std::string _error;
+};
+
+// the calling thread's group, opened on its first use
+CounterGroup &threadCounters();
+
+#endif
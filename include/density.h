@@ -0,0 +1,65 @@
+#ifndef DENSITY_H
+#define DENSITY_H
+
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "camera.h"
+#include "picture.h"
+#include "planet.h"
+
+enum class ToneMap { Log, Gamma };
+
+// returns the tone map with the given name, throws std::invalid_argument if
+// none
+ToneMap parseToneMap(const std::string &name);
+
+// Counts how many bodies land on each pixel instead of overwriting pixels, so
+// large populations show where they are dense rather than saturating. Every
+// accumulating thread counts into its own tile, and tiles are only merged
+// when rendering
+class DensityMap {
+public:
+  /**
+     @param camera projects bodies onto the picture it renders into
+  */
+  explicit DensityMap(const Camera &camera);
+
+  // Counts every body into the calling thread's tile. Safe to call from
+  // several threads at once
+  void accumulate(const std::vector<StateVector> &bodies);
+
+  // Counts bodies split evenly across threadCount threads
+  void accumulate(const std::vector<StateVector> &bodies, unsigned threadCount);
+
+  /**
+     Merges every tile and blends color over pic in proportion to each
+     pixel's tone mapped count, the densest pixel taking color. An indexed
+     pic is switched to packed pixels first.
+     @param pic the picture to draw into, at least size pixels each side
+     @param color the color of the densest pixel
+     @param mapping log(1 + count) or count^(1 / gamma), both scaled by the
+     densest pixel
+     @param gamma the exponent of Gamma mapping
+  */
+  void render(Picture &pic, rgbColor color, ToneMap mapping,
+              double gamma = 2.2) const;
+
+private:
+  std::vector<uint32_t> &tile();
+  void count(const StateVector *begin, const StateVector *end,
+             std::vector<uint32_t> &counts) const;
+
+  const Camera _camera;
+  const int _size;
+
+  // tiles never move once created
+  std::map<std::thread::id, std::vector<uint32_t>> _tiles;
+  mutable std::mutex _mutex;
+};
+
+#endif
@@ -0,0 +1,54 @@
+#ifndef DIAGNOSTICS_H
+#define DIAGNOSTICS_H
+
+#include <string>
+#include <vector>
+
+#include "coord.h"
+#include "planet.h"
+
+// Quantities a closed system conserves, sampled at one moment
+struct Invariants {
+  double seconds;        // since the start of the integration
+  double energy;         // kinetic + potential [J]
+  Coord angularMomentum; // [kg m^2/s]
+  Coord momentum;        // [kg m/s]
+  Coord barycenter;      // [m]
+  double mass;           // [kg]
+};
+
+// Collects invariants every interval steps of a single integration. The
+// potential energy is handed over by the force pass that already computed the
+// pair distances, the remaining terms are one pass over the bodies. Pair
+// forces are equal and opposite, so drift measures integration error only,
+// and mergers or ejections change the invariants themselves
+class Diagnostics {
+public:
+  Diagnostics(int dt, int interval = 1);
+
+  // whether the step about to be taken should be sampled
+  bool isDue() const { return _stepsSeen % _interval == 0; }
+
+  // called once per step with the bodies at the start of the step. The
+  // potential energy is only read when the step was due
+  void onStep(const std::vector<StateVector> &bodies, double potentialEnergy);
+
+  const std::vector<Invariants> &samples() const { return _samples; }
+
+private:
+  std::vector<Invariants> _samples;
+  const int _dt;
+  const int _interval;
+  long long _stepsSeen = 0;
+};
+
+// Invariants of bodies given the potential energy of the system
+Invariants calcInvariants(const std::vector<StateVector> &bodies,
+                          double potentialEnergy, double seconds);
+
+// writes the time series with drift relative to the sample at zero seconds,
+// and returns the largest relative energy drift
+double writeInvariants(const std::string &filename,
+                       const std::vector<Invariants> &samples);
+
+#endif
@@ -0,0 +1,71 @@
+#ifndef ENCOUNTER_H
+#define ENCOUNTER_H
+
+#include <utility>
+#include <vector>
+
+#include "planet.h"
+
+// Re-integrates bodies passing within a multiple of their Hill radius of each
+// other with Bulirsch-Stoer, which subdivides the step as finely as the
+// encounter needs. Every other body keeps the regular step. Encounters are
+// found by the force pass, which already has every pair's distance, so
+// watching for them costs one comparison per pair. The most massive body is
+// the central body and never encounters anything. Holds scratch space, so use
+// one per integrating thread
+class EncounterSolver {
+public:
+  explicit EncounterSolver(double hillRadii, double tolerance = 1e-12);
+
+  // Squared encounter radius of every body, its scaled Hill radius about the
+  // central body, and negative for the central body. Pairs closer than the
+  // larger of their radii encounter each other
+  const std::vector<double> &
+  updateRadii(const std::vector<StateVector> &bodies);
+
+  // pairs of body indices found encountering by the force pass
+  std::vector<std::pair<size_t, size_t>> &pairs() { return _pairs; }
+
+  // Replaces the updated state of every body in one of pairs with a
+  // Bulirsch-Stoer step of dt seconds from bodies, under the same forces as
+  // the regular step. Returns the indices of the bodies replaced
+  const std::vector<size_t> &resolve(const std::vector<StateVector> &bodies,
+                                     std::vector<StateVector> &updatedBodies,
+                                     int dt);
+
+  // number of encountering pairs seen so far
+  size_t encounterCount() const { return _encounterCount; }
+
+private:
+  using GroupState = std::vector<double>;
+
+  void derivative(const std::vector<size_t> &group, const GroupState &y,
+                  GroupState &dydt);
+  void modifiedMidpoint(const std::vector<size_t> &group, const GroupState &y,
+                        double h, int substeps, GroupState &result);
+  void bulirschStoer(const std::vector<size_t> &group, GroupState &y,
+                     double h, int depth);
+
+  // derivative evaluations allowed for one group over one step
+  static const int kMaxEvaluations = 1 << 14;
+
+  const double _hillRadii;
+  const double _tolerance;
+  int _evaluationsLeft = 0;
+  size_t _encounterCount = 0;
+
+  std::vector<double> _radii;
+  std::vector<double> _factors;
+  std::vector<double> _factorMasses;
+  double _centralMass = 0.0;
+  std::vector<std::pair<size_t, size_t>> _pairs;
+  std::vector<size_t> _parents;
+  std::vector<size_t> _resolved;
+
+  // bodies with the encountering group's trial positions
+  std::vector<StateVector> _work;
+  std::vector<bool> _isInGroup;
+  std::vector<Coord> _groupAcc;
+};
+
+#endif
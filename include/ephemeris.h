@@ -0,0 +1,38 @@
+#ifndef EPHEMERIS_H
+#define EPHEMERIS_H
+
+#include <map>
+#include <shared_mutex>
+#include <string>
+#include <vector>
+
+#include "planet.h"
+
+// Loaded orbital elements and J2000 state vectors, kept in memory between
+// queries. N-body queries resume from the nearest integrated checkpoint
+// instead of from J2000, and store new checkpoints as they pass them.
+class Ephemeris {
+public:
+  Ephemeris(const std::string &planetsFile, const std::string &solutionsFile,
+            double checkpointDays = 30.0);
+
+  // One-body approximation at the given epoch
+  std::vector<StateVector> keplerian(double daysSinceEpoch) const;
+
+  // N-body model at the given epoch, safe to call from several threads
+  std::vector<StateVector> nBody(double daysSinceEpoch);
+
+  // number of integrated states held in memory
+  size_t checkpointCount() const;
+
+private:
+  std::vector<OrbitalElements> _elements;
+  std::vector<StateVector> _bodies;
+
+  // integrated states keyed by signed step count from J2000
+  std::map<int, std::vector<StateVector>> _checkpoints;
+  mutable std::shared_mutex _mutex;
+  int _checkpointSteps;
+};
+
+#endif
@@ -0,0 +1,28 @@
+#ifndef FRAME_H
+#define FRAME_H
+
+#include <string>
+#include <vector>
+
+#include "planet.h"
+
+// Coordinate frames state vectors can be expressed in. The central body is
+// the most massive one, and Jacobi coordinates nest the other bodies in the
+// order they are listed
+//   Heliocentric: positions and velocities relative to the central body
+//   Barycentric: positions and velocities relative to the center of mass
+//   Democratic: heliocentric positions with barycentric velocities
+//   Jacobi: each body relative to the center of mass of the central body
+//           and every body listed before it
+// In every frame but heliocentric the central body's entry holds the center
+// of mass of the whole system. Integration always runs barycentric, so frames
+// only apply to output and there is no conversion back
+enum class Frame { Heliocentric, Barycentric, Democratic, Jacobi };
+
+// returns the frame with the given name, throws std::invalid_argument if none
+Frame parseFrame(const std::string &name);
+
+// converts state vectors from any inertial frame into frame, in place
+void toFrame(std::vector<StateVector> &bodies, Frame frame);
+
+#endif
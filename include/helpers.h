@@ -5,12 +5,21 @@
 #include <iostream>
 #include <vector>
 
+#include "camera.h"
+#include "catalog.h"
 #include "picture.h"
 #include "planet.h"
 
 
+// color of path points
+extern const rgbColor cPath;
+
+// Draws every body camera sees as a path point, or as a square of side
+// 2 * halfWidth + 1 in its catalog color when isPath is false (white for
+// bodies missing from catalog). pic holds the camera's window
 void drawBodies(const std::vector<StateVector> &bodies, Picture &pic,
-                size_t systemSize, bool isPath = true);
+                const Camera &camera, bool isPath = true,
+                const Catalog *catalog = nullptr, int halfWidth = 1);
 
 // approximates system size, assumes eccentricity is low
 size_t approxSystemSize(const std::vector<OrbitalElements> &elements);
@@ -4,8 +4,11 @@
 #include <string>
 #include <vector>
 
+#include "date.h"
 #include "planet.h"
 
+enum class Format { Text, CSV, JSON };
+
 // requests and returns text input from user
 std::string getString(const std::string &prompt);
 
@@ -14,11 +17,28 @@ std::string getString(const std::string &prompt);
 double getDate();
 
 
-// displays formatted results
+// parses a MM/DD/YYYY string, returns false if formatted incorrectly
+bool parseDate(const std::string &dateAsString, Date &date);
+
+
+// reads one MM/DD/YYYY date per line and returns days since J2000 epoch
+std::vector<double> readDates(const std::string &filename);
+
+
+// displays formatted results, distances from the central body and from Earth
+// when it is one of planets
 void printResults(const std::vector<StateVector> &planets);
 
 
+// displays every snapshot in the requested format
+void printSnapshots(const std::vector<Snapshot> &snapshots,
+                    const Format format);
+
+
+// gets answers from solutions.json and display formatted comparison of every
+// body they cover, matched by name
 void printTest(const std::vector<StateVector> &bodies,
-               const double daysSinceEpoch);
+               const double daysSinceEpoch,
+               const std::string &solutionsFile = "solutions.json");
 
 #endif
@@ -1,20 +1,30 @@
 #ifndef JSON_H
 #define JSON_H
 
+#include <string>
 #include <vector>
 
+#include "catalog.h"
 #include "planet.h"
 
 
-// reads planets.json into a parallel vectors
+// reads planets.json into a parallel vectors, and every body's optional
+// radius, class and color into catalog when it is not null
 void populatePlanets(std::vector<OrbitalElements> &elements,
-                     std::vector<StateVector> &bodies);
+                     std::vector<StateVector> &bodies,
+                     const std::string &filename = "planets.json",
+                     Catalog *catalog = nullptr);
 
 
 void populateSolutions(std::vector<StateVector> &bodies,
-                       const double daysSinceEpoch);
-
-void populateStateVectors(std::vector<StateVector> &bodies);
+                       const double daysSinceEpoch,
+                       const std::string &filename = "solutions.json");
+
+// Sets the J2000 state of every body in bodies from the file, matched by
+// name. Bodies in the file but not in bodies are ignored. Throws
+// std::range_error if any body but the central one has no state
+void populateStateVectors(std::vector<StateVector> &bodies,
+                          const std::string &filename = "solutions.json");
 
 
 #endif
@@ -10,4 +10,15 @@ void keplerianApprox(const std::vector<OrbitalElements> &elements,
                      std::vector<StateVector> &bodies,
                      const double daysSinceEpoch);
 
+// returns numerical approximation of Eccentric Anomaly (E) using the
+// Newton-Raphson method
+double calcEccentricAnomaly(double eccentricity, double meanAnomaly);
+
+// One-body approximation at every snapshot's epoch, split across threads.
+// snapshotObserver, when given, sees every snapshot as its thread finishes it
+void keplerianApprox(const std::vector<OrbitalElements> &elements,
+                     const std::vector<StateVector> &bodies,
+                     std::vector<Snapshot> &snapshots, unsigned threadCount,
+                     const SnapshotObserver &snapshotObserver = nullptr);
+
 #endif
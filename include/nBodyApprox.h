@@ -1,13 +1,173 @@
 #ifndef UPDATE_H
 #define UPDATE_H
 
+#include <functional>
+#include <memory>
+#include <string>
+#include <utility>
 #include <vector>
 
+#include "camera.h"
+#include "diagnostics.h"
 #include "picture.h"
 #include "planet.h"
 
+class CollisionSolver;
+class EncounterSolver;
+
+// Optional behaviour of the N-body integrator
+struct IntegratorOptions {
+  // compensated summation of position and velocity updates
+  bool isCompensated = false;
+
+  // bodies closer than this many Hill radii are re-integrated with
+  // Bulirsch-Stoer, zero disables encounter handling
+  double encounterHillRadii = 0.0;
+
+  // bodies whose radii, scaled by this, overlap are merged, zero disables
+  // mergers
+  double collisionRadiusScale = 0.0;
+
+  // bodies farther than this from the central body are removed [m], zero
+  // disables ejection
+  double ejectionDistance = 0.0;
+};
+
+// Stage increments of one 4th-Order Runge-Kutta step, enough to evaluate the
+// step's continuous extension anywhere inside it
+struct RungeKuttaStages {
+  Coord kv[4];
+  Coord kr[4];
+};
+
+// Round-off lost by the last position and velocity updates of one body, added
+// back on its next step when integrating with compensated summation
+struct Compensation {
+  Coord pos;
+  Coord vel;
+};
+
+// Evaluates the continuous extension of a Runge-Kutta step a fraction theta
+// (0 to 1) of the way through it, without any extra force evaluations
+StateVector denseOutput(const StateVector &start,
+                        const RungeKuttaStages &stages, double theta);
+
+// Called with every body's state before each integration step
+using StepObserver = std::function<void(const std::vector<StateVector> &)>;
+
+// Updates acceleration vectors for both bodies involved [m/s/s], and the
+// potential energy of the pair when it is not null [J]. Returns the squared
+// distance between the bodies [m^2]
+double calcAcc(const StateVector &p1, const StateVector &p2, Coord &acc1,
+               Coord &acc2, double *potentialEnergy = nullptr);
+
+// Acceleration of body p, at index pIndex of planets, from every other body
+Coord sumAcc(const StateVector &p, size_t pIndex,
+             const std::vector<StateVector> &planets);
+
+// Acceleration of every body at its current position into acc [m/s/s],
+// visiting every pair once and applying its force to both bodies. Adds the
+// potential energy of every pair when potentialEnergy is not null [J]. When
+// encounterRadii, squared [m^2], is not null, every pair closer than the
+// larger of its two radii, neither negative, is appended to encounters
+void accelerations(
+    const std::vector<StateVector> &bodies, std::vector<Coord> &acc,
+    double *potentialEnergy = nullptr,
+    const std::vector<double> *encounterRadii = nullptr,
+    std::vector<std::pair<size_t, size_t>> *encounters = nullptr);
+
+// Acceleration of every body at its current position [m/s/s]
+std::vector<Coord> accelerations(const std::vector<StateVector> &bodies);
+
+// Advances every body by one step of dt seconds into updatedBodies, keeping
+// each body's stage increments when stages is not null and reusing initialAcc
+// as the first stage when it is not null. Adds the system's potential energy
+// at the start of the step to potentialEnergy when it is not null. Updates
+// use compensated summation when compensation is not null, and bodies in a
+// close encounter are re-integrated by encounters when it is not null
+void step(const std::vector<StateVector> &bodies,
+          std::vector<StateVector> &updatedBodies, int dt,
+          std::vector<RungeKuttaStages> *stages = nullptr,
+          const std::vector<Coord> *initialAcc = nullptr,
+          double *potentialEnergy = nullptr,
+          std::vector<Compensation> *compensation = nullptr,
+          EncounterSolver *encounters = nullptr);
+
+// Advances every body by the given number of steps of dt seconds, showing the
+// bodies to observer before each step and sampling them into diagnostics.
+// Updates use compensated summation when compensation is not null, and bodies
+// in a close encounter are re-integrated by encounters when it is not null.
+// After each step, collisions merges and ejects bodies when it is not null,
+// so bodies may shrink
+void integrate(std::vector<StateVector> &bodies, int steps, int dt,
+               const StepObserver &observer = nullptr,
+               Diagnostics *diagnostics = nullptr,
+               std::vector<Compensation> *compensation = nullptr,
+               EncounterSolver *encounters = nullptr,
+               CollisionSolver *collisions = nullptr);
+
+// State of bodies at a (possibly fractional) number of steps of dt seconds
+// ahead. Whole steps are integrated and the remainder is read from the
+// continuous extension of the step containing it. That step is kept, so later
+// requests landing in it or advancing past it do not compute it again.
+// Requests must not decrease. initialAcc, when given, is the acceleration of
+// bodies and replaces the first step's first force evaluation. Every step
+// taken is sampled into diagnostics when it is not null. Inside a step with
+// an encounter, dense output of the encountering bodies falls back to the
+// regular step's continuous extension. With collisions enabled, results may
+// hold fewer bodies than the start
+class DenseIntegrator {
+public:
+  DenseIntegrator(const std::vector<StateVector> &bodies, int dt,
+                  StepObserver observer = nullptr,
+                  std::vector<Coord> initialAcc = {},
+                  Diagnostics *diagnostics = nullptr,
+                  const IntegratorOptions &options = {});
+  ~DenseIntegrator();
+
+  std::vector<StateVector> at(double steps);
+
+private:
+  void computeNext();
+  void advance(int whole);
+
+  std::vector<StateVector> _bodies;
+  std::vector<StateVector> _next;
+  std::vector<RungeKuttaStages> _stages;
+  std::vector<Coord> _initialAcc;
+  std::vector<Compensation> _compensation;
+  std::vector<Compensation> _nextCompensation;
+  bool _hasNext = false;
+  double _potentialEnergy = 0.0;
+  int _stepsTaken = 0;
+  const int _dt;
+  StepObserver _observer;
+  Diagnostics *_diagnostics;
+  std::unique_ptr<EncounterSolver> _encounters;
+  std::unique_ptr<CollisionSolver> _collisions;
+};
+
+// observer drawing the bodies of every step onto pic as paths, safe to share
+// between threads
+StepObserver pathDrawer(Picture &pic, const Camera &camera);
+
 // N-body model of Jovian planets
 void nBodyApprox(std::vector<StateVector> &bodies, double daysSinceEpoch,
                  Picture &pic, size_t systemSize);
 
+// N-body model evaluated at every snapshot's epoch in a single sweep per
+// direction, past and future epochs on separate threads. pathObserver, when
+// given, sees the bodies of every step from both threads. When invariants is
+// not null it receives the system's invariants every diagnosticsInterval
+// steps, oldest first. snapshotObserver, when given, sees every snapshot as
+// its sweep passes it, outward from J2000 on each side
+void nBodyApprox(const std::vector<StateVector> &bodies,
+                 std::vector<Snapshot> &snapshots,
+                 const StepObserver &pathObserver = nullptr,
+                 const std::string &solutionsFile = "solutions.json",
+                 std::vector<Invariants> *invariants = nullptr,
+                 int diagnosticsInterval = 4,
+                 const IntegratorOptions &integratorOptions = {},
+                 const SnapshotObserver &snapshotObserver = nullptr);
+
 #endif
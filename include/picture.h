@@ -1,10 +1,12 @@
 #ifndef PICTURE_H
 #define PICTURE_H
 
+#include <cstdint>
 #include <string>
 #include <vector>
 
 #include "lodepng.h"
+#include "png.h"
 
 struct rgbColor {
   int r = 255;
@@ -12,6 +14,16 @@ struct rgbColor {
   int b = 255;
 };
 
+// pixel position of a blit
+struct Point {
+  int x;
+  int y;
+};
+
+// Pixels are stored packed, one 32-bit word per pixel holding the red, green,
+// blue and alpha bytes in memory order. In indexed mode each pixel is instead
+// one byte indexing a palette of up to 256 colors, a quarter of the memory,
+// and saves as a paletted PNG. A 257th color switches back to packed pixels
 class Picture {
 public:
   /**
@@ -60,6 +72,13 @@ public:
   */
   void save(std::string filename) const;
 
+  /**
+     Saves this picture to the given file with the fast encoder.
+     @param filename a file name that should specify a PNG file.
+     @param options compression level, filter and thread count
+  */
+  void save(std::string filename, const PngOptions &options) const;
+
   /**
      Yields the red value at the given position.
      @param x the x-coordinate (column)
@@ -98,6 +117,100 @@ public:
   */
   void set(int x, int y, rgbColor color);
 
+  /**
+     Sets every point to a color. Grows the picture once to fit every
+     point, or clips them to a fixed canvas.
+     @param points the pixels to set
+     @param color the color of every point
+  */
+  void plot(const std::vector<Point> &points, rgbColor color);
+
+  /**
+     Blends a color over every point by its coverage, 0 keeping the pixel
+     and 1 replacing it. Grows the picture once to fit every point, or clips
+     them to a fixed canvas. An indexed picture switches to packed pixels
+     first, as blends make new colors.
+     @param points the pixels to blend
+     @param coverage the coverage of the point at the same index
+     @param color the color blended in
+  */
+  void blend(const std::vector<Point> &points,
+             const std::vector<float> &coverage, rgbColor color);
+
+  /**
+     Draws a filled square of side 2 * halfWidth + 1 around every center.
+     Grows the picture once to fit every square, or clips them to a fixed
+     canvas.
+     @param centers the center of every square
+     @param colors the color of the square at the same index
+     @param halfWidth pixels between a center and the edges of its square
+  */
+  void stamp(const std::vector<Point> &centers,
+             const std::vector<rgbColor> &colors, int halfWidth);
+
+  /**
+     Sets whether this picture keeps its size, clipping pixels drawn outside
+     it, instead of growing to fit them.
+     @param isFixed true to clip, false to grow
+  */
+  void setFixed(bool isFixed) { _isFixed = isFixed; }
+
+  /**
+     Switches between packed and indexed pixels, keeping the image.
+     @param isIndexed true for palette indices, false for packed pixels
+     @return false if the image has more than 256 colors to index, in
+     which case it stays packed
+  */
+  bool setIndexed(bool isIndexed);
+
+  /**
+     Yields whether pixels are palette indices.
+     @return true in indexed mode
+  */
+  bool isIndexed() const { return _isIndexed; }
+
+  /**
+     Yields the packed pixels of a row, without bounds checks. Only valid
+     when the picture is not indexed.
+     @param y the row, between 0 and height - 1
+     @return the row's first pixel, followed by the rest of the row
+  */
+  uint32_t *row(int y) { return _pixels.data() + size_t(y) * _width; }
+  const uint32_t *row(int y) const {
+    return _pixels.data() + size_t(y) * _width;
+  }
+
+  /**
+     Yields the palette indices of a row, without bounds checks. Only valid
+     when the picture is indexed.
+     @param y the row, between 0 and height - 1
+     @return the row's first index, followed by the rest of the row
+  */
+  uint8_t *indexRow(int y) { return _indices.data() + size_t(y) * _width; }
+  const uint8_t *indexRow(int y) const {
+    return _indices.data() + size_t(y) * _width;
+  }
+
+  /**
+     Yields the palette of an indexed picture.
+     @return the packed color of every index in use
+  */
+  const std::vector<uint32_t> &palette() const { return _palette; }
+
+  /**
+     Packs a color into a pixel word.
+     @param color the color to pack, fully opaque
+     @return the packed pixel
+  */
+  static uint32_t pack(rgbColor color);
+
+  /**
+     Unpacks a pixel word into its color, dropping alpha.
+     @param pixel the packed pixel
+     @return its red, green and blue values
+  */
+  static rgbColor unpack(uint32_t pixel);
+
   /**
      Yields the gray levels of all pixels of this image.
      @return a 2D array of gray values (between 0 and 255)
@@ -113,14 +226,49 @@ public:
   */
   void add(const Picture &other, int x = 0, int y = 0);
 
-  void scale(const size_t factor);
+  /**
+     Scales this picture up, repeating every pixel factor times in both
+     directions. Works in place, allocating only when the buffer has less
+     capacity than the scaled picture needs (see reserve).
+     @param factor the scale factor
+     @param threadCount rows are split across this many threads
+  */
+  void scale(const size_t factor, unsigned threadCount = 1);
+
+  /**
+     Scales this picture down, averaging every factor x factor block of
+     pixels into one (a box filter), so a picture drawn at factor times the
+     size comes out anti-aliased. Edge pixels that do not fill a block are
+     dropped. Works in place, and switches an indexed picture to packed
+     pixels first.
+     @param factor the scale factor
+     @param threadCount rows are split across this many threads
+  */
+  void downsample(const size_t factor, unsigned threadCount = 1);
+
+  /**
+     Preallocates room for a picture of the given size, so scaling up to it
+     does not allocate.
+     @param width the width to make room for
+     @param height the height to make room for
+  */
+  void reserve(int width, int height);
 
 private:
   void ensure(int x, int y);
+  int indexOf(uint32_t pixel);
+  uint32_t pixel(int x, int y) const;
+  const unsigned char *bytes() const {
+    return reinterpret_cast<const unsigned char *>(_pixels.data());
+  }
 
-  std::vector<unsigned char> _values;
+  std::vector<uint32_t> _pixels;
+  std::vector<uint8_t> _indices;
+  std::vector<uint32_t> _palette;
+  bool _isIndexed = false;
   int _width;
   int _height;
+  bool _isFixed = false;
 };
 
 #endif
@@ -2,13 +2,30 @@
 #define PLANET_H
 
 #include "coord.h"
+#include <cstdint>
+#include <functional>
 #include <string>
+#include <vector>
+
+// Body names are interned once when loaded, so everything past loading
+// compares and indexes bodies by integer. Id 0 is the empty name
+using BodyId = uint32_t;
+
+// id of name, interning it if it is new. Safe to call from several threads
+BodyId internName(const std::string &name);
+
+// id of an already interned name, false if it was never interned
+bool findBodyId(const std::string &name, BodyId &id);
+
+// name of an interned id, throws std::out_of_range if there is none
+const std::string &bodyName(BodyId id);
 
 struct StateVector {
-  std::string name;
+  BodyId id;
   Coord pos;
   Coord vel;
   double mass;
+  double radius = 0.0; // [m], zero never collides
 };
 
 struct OrbitalElements {
@@ -20,4 +37,14 @@ struct OrbitalElements {
   double meanAnomaly;
 };
 
+// state of every body at one moment in time
+struct Snapshot {
+  double daysSinceEpoch;
+  std::vector<StateVector> bodies;
+};
+
+// Called with each snapshot and its index as soon as it is computed, possibly
+// from several threads at once and not in index order
+using SnapshotObserver = std::function<void(size_t, const Snapshot &)>;
+
 #endif
@@ -0,0 +1,101 @@
+#ifndef PNG_H
+#define PNG_H
+
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+
+enum class PngFilter { None, Sub, Up, Average, Paeth, Adaptive };
+
+// returns the filter with the given name, throws std::invalid_argument if
+// none
+PngFilter parsePngFilter(const std::string &name);
+
+// Settings of the fast PNG encoder
+struct PngOptions {
+  // 0 stores rows uncompressed, 1 to 9 search progressively harder for
+  // repeated bytes
+  int level = 1;
+
+  // row filter, Adaptive picks the smallest of the others for every row
+  PngFilter filter = PngFilter::Up;
+
+  // row strips deflated at once
+  unsigned threads = 1;
+};
+
+/**
+   Encodes an RGBA image as PNG, writing RGB when every pixel is opaque. The
+   image is split into one strip of rows per thread and each strip is
+   deflated independently, ending on a byte boundary, so the strips join into
+   a single zlib stream.
+   @param rgba the pixels, four bytes each, row by row
+   @param width the width of the image
+   @param height the height of the image
+   @param options compression level, filter and thread count
+   @return the PNG file's bytes
+*/
+std::vector<unsigned char> encodePng(const unsigned char *rgba, unsigned width,
+                                     unsigned height,
+                                     const PngOptions &options = {});
+
+/**
+   Encodes palette indices as a paletted PNG, the same way as encodePng.
+   @param indices one byte per pixel, row by row
+   @param palette the packed RGBA color of every index, at most 256
+   @param width the width of the image
+   @param height the height of the image
+   @param options compression level, filter and thread count
+   @return the PNG file's bytes
+*/
+std::vector<unsigned char>
+encodeIndexedPng(const unsigned char *indices,
+                 const std::vector<uint32_t> &palette, unsigned width,
+                 unsigned height, const PngOptions &options = {});
+
+// Writes an opaque RGB PNG one band of rows at a time, so an image too large
+// to hold never has to be whole in memory. Every band is filtered and
+// deflated like encodePng and written out as its own IDAT chunk, the bands
+// joining into a single zlib stream
+class PngStream {
+public:
+  /**
+     Opens the file and writes the PNG header.
+     @param filename the file to write
+     @param width the width of the image
+     @param height the height of the image
+     @param options compression level, filter and threads per band
+  */
+  PngStream(const std::string &filename, unsigned width, unsigned height,
+            const PngOptions &options = {});
+
+  /**
+     Appends the next rows of the image, dropping alpha.
+     @param rgba the pixels, four bytes each, row by row
+     @param rows the number of rows, within the height left
+  */
+  void write(const unsigned char *rgba, unsigned rows);
+
+  /**
+     Ends the file. Throws std::logic_error if fewer rows than the height
+     were written.
+  */
+  void finish();
+
+private:
+  void writeBytes(const std::vector<unsigned char> &bytes);
+
+  std::ofstream _file;
+  std::string _filename;
+  unsigned _width;
+  unsigned _height;
+  PngOptions _options;
+
+  // last row of the previous band, which the first row filters against
+  std::vector<unsigned char> _previous;
+  unsigned _rowsWritten = 0;
+  uint32_t _checksum = 1;
+};
+
+#endif
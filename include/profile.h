@@ -0,0 +1,93 @@
+#ifndef PROFILE_H
+#define PROFILE_H
+
+#include <cstdint>
+#include <ostream>
+#include <string>
+
+#include "counters.h"
+
+// Scoped instrumentation of the hot paths. PROFILE_SCOPE("name") times the
+// rest of its block, and compiles to nothing unless the program is built with
+// ENABLE_PROFILING (make PROFILE=1). Names must be string literals. Every
+// thread records into its own ring buffer of its most recent events and its
+// own per-scope statistics, so threads never wait on each other. Statistics
+// are written to stderr at exit, and writeTrace exports the buffered events
+// for chrome://tracing or Perfetto. PROFILE_COUNTERS("name") also counts the
+// block's hardware events while counting is turned on
+
+// true when scopes are compiled in
+constexpr bool isProfilingEnabled() {
+#ifdef ENABLE_PROFILING
+  return true;
+#else
+  return false;
+#endif
+}
+
+// nanoseconds on the profiling clock
+uint64_t profileClock();
+
+// records one completed scope on the calling thread
+void profileRecord(const char *name, uint64_t start, uint64_t end);
+
+// Writes every buffered event as Chrome trace-event JSON, throws
+// std::runtime_error if the file cannot be written
+void writeTrace(const std::string &filename);
+
+// Writes the count, total, median and 99th percentile time of every scope,
+// merged over all threads, slowest total first
+void writeProfileStats(std::ostream &out);
+
+// Turns counting in PROFILE_COUNTERS scopes on or off. Off by default, since
+// reading the counters takes a system call at either end of every scope
+void setProfileCounting(bool isCounting);
+
+// records the events of one completed counted scope on the calling thread
+void profileCount(const char *name, const CounterValues &events);
+
+// times its own lifetime
+class ProfileScope {
+public:
+  explicit ProfileScope(const char *name)
+      : _name(name), _start(profileClock()) {}
+  ~ProfileScope() { profileRecord(_name, _start, profileClock()); }
+
+  ProfileScope(const ProfileScope &) = delete;
+  ProfileScope &operator=(const ProfileScope &) = delete;
+
+private:
+  const char *_name;
+  uint64_t _start;
+};
+
+// times its own lifetime, and counts its events while counting is on
+class CountedScope {
+public:
+  explicit CountedScope(const char *name);
+  ~CountedScope();
+
+  CountedScope(const CountedScope &) = delete;
+  CountedScope &operator=(const CountedScope &) = delete;
+
+private:
+  ProfileScope _scope;
+  const char *_name;
+  bool _isCounting;
+  CounterValues _start;
+};
+
+#define PROFILE_JOIN_(a, b) a##b
+#define PROFILE_JOIN(a, b) PROFILE_JOIN_(a, b)
+
+#ifdef ENABLE_PROFILING
+#define PROFILE_SCOPE(name)                                                    \
+  ProfileScope PROFILE_JOIN(profileScope, __LINE__)(name)
+#define PROFILE_COUNTERS(name)                                                 \
+  CountedScope PROFILE_JOIN(profileScope, __LINE__)(name)
+#else
+#define PROFILE_SCOPE(name) ((void)0)
+#define PROFILE_COUNTERS(name) ((void)0)
+#endif
+
+#endif
@@ -0,0 +1,27 @@
+#ifndef SERVER_H
+#define SERVER_H
+
+#include <string>
+
+#include "ephemeris.h"
+#include "threadPool.h"
+
+// Line protocol, one request per line:
+//   <id> kepler|nbody <MM/DD/YYYY or JD<julian day>> [frame]
+//   <id> stats
+// Each response is one line starting with the request id, so requests may be
+// pipelined and answered out of order:
+//   <id> OK <julian day> <name>:<x>,<y>,<z>,<vx>,<vy>,<vz> ...
+//   <id> ERR <message>
+
+// answers a single request line
+std::string handleRequest(Ephemeris &ephemeris, const std::string &request);
+
+// answers requests from stdin on the pool until end of input
+void serveStream(Ephemeris &ephemeris, ThreadPool &pool);
+
+// answers requests from every client of a Unix domain socket at path
+void serveSocket(Ephemeris &ephemeris, ThreadPool &pool,
+                 const std::string &path);
+
+#endif
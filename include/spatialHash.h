@@ -0,0 +1,42 @@
+#ifndef SPATIAL_HASH_H
+#define SPATIAL_HASH_H
+
+#include <cstdint>
+#include <functional>
+#include <utility>
+#include <vector>
+
+#include "planet.h"
+
+// Buckets bodies into cubic cells so that pairs within one cell width of each
+// other are found by checking neighbouring cells instead of every pair. Cells
+// are kept in a sorted array, so rebuilding every step does not allocate once
+// it has grown to the number of bodies
+class SpatialHash {
+public:
+  /**
+     Buckets every body.
+     @param bodies the bodies to bucket
+     @param cellSize the width of a cell, at least the largest reach [m]
+  */
+  void build(const std::vector<StateVector> &bodies, double cellSize);
+
+  /**
+     Collects every pair (i < j) closer than reach(i, j), which must not
+     exceed the cell size.
+     @param bodies the bodies the hash was built from
+     @param reach the largest distance at which i and j count as close [m]
+     @param pairs receives the close pairs, sorted
+  */
+  void findPairs(const std::vector<StateVector> &bodies,
+                 const std::function<double(size_t, size_t)> &reach,
+                 std::vector<std::pair<size_t, size_t>> &pairs) const;
+
+private:
+  int64_t cellOf(double x) const;
+
+  double _cellSize = 0.0;
+  std::vector<std::pair<int64_t, size_t>> _cells;
+};
+
+#endif
@@ -0,0 +1,56 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+class ThreadPool {
+public:
+  /**
+     Starts the given number of worker threads (at least one).
+     @param threadCount the number of workers
+  */
+  explicit ThreadPool(unsigned threadCount);
+
+  /**
+     Finishes every queued task, then joins the workers.
+  */
+  ~ThreadPool();
+
+  ThreadPool(const ThreadPool &) = delete;
+  ThreadPool &operator=(const ThreadPool &) = delete;
+
+  /**
+     Queues a task to run on the next free worker.
+     @param task the work to run
+  */
+  void submit(std::function<void()> task);
+
+  /**
+     Blocks until the queue is empty and no task is running.
+  */
+  void wait();
+
+  /**
+     Returns the number of worker threads.
+     @return the worker count
+  */
+  size_t size() const { return _workers.size(); }
+
+private:
+  void work();
+
+  std::vector<std::thread> _workers;
+  std::queue<std::function<void()>> _tasks;
+  std::mutex _mutex;
+  std::condition_variable _taskReady;
+  std::condition_variable _idle;
+  size_t _running = 0;
+  bool _stopping = false;
+};
+
+#endif
@@ -0,0 +1,58 @@
+#ifndef TILES_H
+#define TILES_H
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "camera.h"
+#include "picture.h"
+#include "planet.h"
+#include "png.h"
+
+// One bit per canvas pixel marking where paths pass, a 32nd of the memory of
+// packed pixels, so the paths of a canvas too large to hold as pixels can
+// still be recorded during integration and drawn tile by tile afterwards
+class PathMask {
+public:
+  /**
+     @param camera projects bodies onto the whole canvas
+  */
+  explicit PathMask(const Camera &camera);
+
+  // Marks the pixel of every body. Safe to call from several threads at once
+  void mark(const std::vector<StateVector> &bodies);
+
+  /**
+     Sets every marked pixel of a tile to color.
+     @param tile the picture holding the window's pixels
+     @param window camera whose window places tile on the canvas
+     @param color the path color
+  */
+  void draw(Picture &tile, const Camera &window, rgbColor color) const;
+
+private:
+  const Camera _camera;
+  const size_t _wordsPerRow;
+  std::unique_ptr<std::atomic<uint64_t>[]> _bits;
+};
+
+/**
+   Renders a square canvas in bands of rows, streaming each band into a PNG
+   as soon as it is drawn, so only one band of pixels is ever held.
+   @param filename the PNG to write
+   @param camera projects onto the whole canvas
+   @param tileRows the height of every band but the last
+   @param background the color of every band before drawing
+   @param draw draws into a band, given a copy of camera windowed to it
+   @param options compression level, filter and threads per band
+*/
+void renderTiles(const std::string &filename, const Camera &camera,
+                 int tileRows, rgbColor background,
+                 const std::function<void(Picture &, const Camera &)> &draw,
+                 const PngOptions &options = {});
+
+#endif
@@ -4,29 +4,34 @@
 
 #include <chrono>
 #include <iostream>
+#include <string>
+#include <utility>
 
+// Prints the time from construction to destruction, or to Stop, on stderr so
+// it never mixes with program output. Hot paths are timed with PROFILE_SCOPE
+// from profile.h instead
 class Timer {
 private:
-  chrono::time_point<chrono::high_resolution_clock> m_StartTimepoint =
-      chrono::high_resolution_clock::now();
+  std::string m_Label;
+  std::chrono::time_point<std::chrono::steady_clock> m_StartTimepoint =
+      std::chrono::steady_clock::now();
+  bool m_Stopped = false;
 
 public:
-  Timer() {};
+  explicit Timer(std::string label = "duration") : m_Label(std::move(label)) {};
   ~Timer() { Stop(); };
 
   void Stop() {
-    auto endTimepoint = chrono::high_resolution_clock::now();
+    if (m_Stopped)
+      return;
+    m_Stopped = true;
 
-    auto start = chrono::time_point_cast<chrono::microseconds>(m_StartTimepoint)
-                     .time_since_epoch()
-                     .count();
-    auto end = chrono::time_point_cast<chrono::microseconds>(endTimepoint)
-                   .time_since_epoch()
-                   .count();
-
-    auto duration = end - start;
-    double ms = duration * 0.001;
-    cout << "duration (ms): " << ms << endl;
+    auto endTimepoint = std::chrono::steady_clock::now();
+    const double ms =
+        std::chrono::duration<double, std::milli>(endTimepoint -
+                                                  m_StartTimepoint)
+            .count();
+    std::cerr << m_Label << " (ms): " << ms << std::endl;
   }
 };
 
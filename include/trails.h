@@ -0,0 +1,64 @@
+#ifndef TRAILS_H
+#define TRAILS_H
+
+#include <map>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "camera.h"
+#include "nBodyApprox.h"
+#include "picture.h"
+#include "planet.h"
+
+// Draws paths as anti-aliased line segments instead of one pixel per body per
+// step. Each body is only sampled again once it has moved spacing pixels on
+// screen, so slow outer bodies are drawn every few dozen steps while fast
+// inner bodies are joined up every step, without gaps. Segments are drawn
+// with Xiaolin Wu's algorithm, two blended pixels per column or row
+class TrailRenderer {
+public:
+  /**
+     @param pic the picture to draw into, holding camera's window
+     @param camera projects bodies onto pic
+     @param color the trail color
+     @param spacing on-screen distance between samples [px]
+  */
+  TrailRenderer(Picture &pic, const Camera &camera, rgbColor color,
+                double spacing = 4.0);
+
+  // Samples every body that has moved far enough since its last sample,
+  // drawing a segment from there. Each calling thread keeps its own samples,
+  // so the past and future sweeps draw separate trails
+  void observe(const std::vector<StateVector> &bodies);
+
+  // observer calling observe, valid while this renderer lives
+  StepObserver observer();
+
+private:
+  // last sample of one body, in window coordinates
+  struct Sample {
+    double x;
+    double y;
+    bool isSet = false;
+  };
+
+  std::vector<Sample> &samples();
+
+  Picture &_pic;
+  const Camera _camera;
+  const rgbColor _color;
+  const double _spacingSquared;
+
+  // sample lists never move once created, each is indexed by body id
+  std::map<std::thread::id, std::vector<Sample>> _samples;
+  std::mutex _samplesMutex;
+  std::mutex _picMutex;
+};
+
+// Appends the pixels of an anti-aliased line between two points in window
+// coordinates, each with its coverage, using Xiaolin Wu's algorithm
+void wuLine(double x0, double y0, double x1, double y1,
+            std::vector<Point> &points, std::vector<float> &coverage);
+
+#endif
@@ -14,6 +14,7 @@
 
 #define G 6.67430e-11   // Gravitational constant
 #define M_SUN 1.9891e30 // [kg]
+#define R_SUN 6.957e8   // [m]
 
 double normalizeRadians(const double x);
 
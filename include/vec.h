@@ -0,0 +1,183 @@
+#ifndef VEC_H
+#define VEC_H
+
+#include <cmath>
+#include <cstddef>
+
+#include "coord.h"
+
+// Fixed-size vectors and 3x3 matrices of any arithmetic type, constexpr
+// throughout except where a square root or trig function is needed. Physics
+// uses double, while float halves the size of data only drawn. Coord stays the
+// type of state vectors, toVec and toCoord convert between the two
+template <typename T, size_t N> struct Vec {
+  T v[N];
+
+  constexpr T &operator[](size_t i) { return v[i]; }
+  constexpr const T &operator[](size_t i) const { return v[i]; }
+
+  constexpr Vec operator+(const Vec &other) const {
+    Vec result{};
+    for (size_t i = 0; i < N; i++) {
+      result.v[i] = v[i] + other.v[i];
+    }
+    return result;
+  }
+
+  constexpr Vec operator-(const Vec &other) const {
+    Vec result{};
+    for (size_t i = 0; i < N; i++) {
+      result.v[i] = v[i] - other.v[i];
+    }
+    return result;
+  }
+
+  constexpr Vec operator-() const {
+    Vec result{};
+    for (size_t i = 0; i < N; i++) {
+      result.v[i] = -v[i];
+    }
+    return result;
+  }
+
+  constexpr Vec operator*(T scalar) const {
+    Vec result{};
+    for (size_t i = 0; i < N; i++) {
+      result.v[i] = v[i] * scalar;
+    }
+    return result;
+  }
+
+  constexpr Vec operator/(T scalar) const {
+    Vec result{};
+    for (size_t i = 0; i < N; i++) {
+      result.v[i] = v[i] / scalar;
+    }
+    return result;
+  }
+
+  constexpr Vec &operator+=(const Vec &other) {
+    for (size_t i = 0; i < N; i++) {
+      v[i] += other.v[i];
+    }
+    return *this;
+  }
+
+  constexpr Vec &operator-=(const Vec &other) {
+    for (size_t i = 0; i < N; i++) {
+      v[i] -= other.v[i];
+    }
+    return *this;
+  }
+
+  constexpr bool operator==(const Vec &other) const {
+    for (size_t i = 0; i < N; i++) {
+      if (v[i] != other.v[i])
+        return false;
+    }
+    return true;
+  }
+};
+
+template <typename T, size_t N>
+constexpr Vec<T, N> operator*(T scalar, const Vec<T, N> &a) {
+  return a * scalar;
+}
+
+template <typename T, size_t N>
+constexpr T dot(const Vec<T, N> &a, const Vec<T, N> &b) {
+  T sum = a.v[0] * b.v[0];
+  for (size_t i = 1; i < N; i++) {
+    sum += a.v[i] * b.v[i];
+  }
+  return sum;
+}
+
+template <typename T>
+constexpr Vec<T, 3> cross(const Vec<T, 3> &a, const Vec<T, 3> &b) {
+  return {a.v[1] * b.v[2] - a.v[2] * b.v[1], a.v[2] * b.v[0] - a.v[0] * b.v[2],
+          a.v[0] * b.v[1] - a.v[1] * b.v[0]};
+}
+
+template <typename T, size_t N> constexpr T normSquared(const Vec<T, N> &a) {
+  return dot(a, a);
+}
+
+template <typename T, size_t N> T norm(const Vec<T, N> &a) {
+  return std::sqrt(normSquared(a));
+}
+
+// the same vector in another component type
+template <typename U, typename T, size_t N>
+constexpr Vec<U, N> vecCast(const Vec<T, N> &a) {
+  Vec<U, N> result{};
+  for (size_t i = 0; i < N; i++) {
+    result.v[i] = static_cast<U>(a.v[i]);
+  }
+  return result;
+}
+
+
+// Row-major 3x3 matrix. Products are sums of row times column, in index
+// order, so a matrix with zeros and ones reproduces its inputs exactly
+template <typename T> struct Mat3 {
+  Vec<T, 3> rows[3];
+
+  static constexpr Mat3 identity() {
+    return {{{1, 0, 0}, {0, 1, 0}, {0, 0, 1}}};
+  }
+
+  // rotation by the angle with the given cosine and sine about an axis,
+  // counterclockwise looking down the axis
+  static constexpr Mat3 rotationX(T c, T s) {
+    return {{{1, 0, 0}, {0, c, -s}, {0, s, c}}};
+  }
+  static constexpr Mat3 rotationZ(T c, T s) {
+    return {{{c, -s, 0}, {s, c, 0}, {0, 0, 1}}};
+  }
+
+  // rotations by an angle [rad]
+  static Mat3 rotationX(T angle) {
+    return rotationX(std::cos(angle), std::sin(angle));
+  }
+  static Mat3 rotationZ(T angle) {
+    return rotationZ(std::cos(angle), std::sin(angle));
+  }
+
+  constexpr Vec<T, 3> &operator[](size_t row) { return rows[row]; }
+  constexpr const Vec<T, 3> &operator[](size_t row) const { return rows[row]; }
+
+  constexpr Vec<T, 3> operator*(const Vec<T, 3> &a) const {
+    return {dot(rows[0], a), dot(rows[1], a), dot(rows[2], a)};
+  }
+
+  constexpr Mat3 operator*(const Mat3 &other) const {
+    const Mat3 columns = other.transposed();
+    Mat3 result{};
+    for (size_t r = 0; r < 3; r++) {
+      result.rows[r] = columns * rows[r];
+    }
+    return result;
+  }
+
+  constexpr Mat3 transposed() const {
+    Mat3 result{};
+    for (size_t r = 0; r < 3; r++) {
+      for (size_t c = 0; c < 3; c++) {
+        result.rows[c].v[r] = rows[r].v[c];
+      }
+    }
+    return result;
+  }
+};
+
+using Vec2f = Vec<float, 2>;
+using Vec3f = Vec<float, 3>;
+using Vec3d = Vec<double, 3>;
+using Mat3f = Mat3<float>;
+using Mat3d = Mat3<double>;
+
+constexpr Vec3d toVec(const Coord &c) { return {c.x, c.y, c.z}; }
+constexpr Coord toCoord(const Vec3d &v) { return {v.v[0], v.v[1], v.v[2]}; }
+
+#endif
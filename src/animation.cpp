@@ -0,0 +1,229 @@
+#include "../include/animation.h"
+#include "../include/camera.h"
+#include "../include/catalog.h"
+#include "../include/helpers.h"
+#include "../include/picture.h"
+#include "../include/planet.h"
+#include "../include/profile.h"
+
+#include <cstdint>
+#include <cstdio>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+
+// returns the policy with the given name, throws std::invalid_argument if
+// none
+Backpressure parseBackpressure(const std::string &name) {
+  if (name == "block")
+    return Backpressure::Block;
+  if (name == "drop")
+    return Backpressure::Drop;
+  throw std::invalid_argument("Unknown frame policy \"" + name + "\"");
+}
+
+
+FramePipeline::FramePipeline(const AnimationOptions &options,
+                             const Camera &camera, rgbColor background,
+                             const Catalog *catalog)
+    : _options(options), _camera(camera), _catalog(catalog),
+      _blank(camera.size(), camera.size(), background),
+      _encoders(options.rawFile.empty() ? options.encoderThreads : 1) {
+  _blank.setFixed(true);
+  _blank.setIndexed(options.isIndexed);
+
+  if (!options.rawFile.empty()) {
+    _raw.open(options.rawFile, std::ios::binary);
+    if (!_raw)
+      throw std::runtime_error("Could not open " + options.rawFile + "\n");
+  }
+
+  // one picture per encoder plus the one being drawn keeps every stage busy
+  for (size_t k = 0; k <= _encoders.size(); k++) {
+    _pictures.push_back(std::make_unique<Picture>(_blank));
+    _freePictures.push_back(_pictures.back().get());
+  }
+
+  _renderer = std::thread(&FramePipeline::render, this);
+}
+
+
+FramePipeline::~FramePipeline() {
+  try {
+    finish();
+  } catch (const std::exception &) {
+  }
+}
+
+
+bool FramePipeline::submit(size_t frame,
+                           const std::vector<StateVector> &bodies) {
+  std::unique_lock<std::mutex> lock(_mutex);
+  if (_queue.size() >= _options.queueCapacity) {
+    if (_options.policy == Backpressure::Drop) {
+      _dropped++;
+      _droppedNumbers.insert(frame);
+      return false;
+    }
+    _queueChanged.wait(
+        lock, [this] { return _queue.size() < _options.queueCapacity; });
+  }
+
+  // snapshot buffers are recycled, so a steady stream copies without
+  // allocating
+  std::vector<StateVector> copy;
+  if (!_spareBodies.empty()) {
+    copy = std::move(_spareBodies.back());
+    _spareBodies.pop_back();
+  }
+  copy.assign(bodies.begin(), bodies.end());
+  _queue.push_back({frame, std::move(copy)});
+
+  lock.unlock();
+  _queueChanged.notify_all();
+  return true;
+}
+
+
+void FramePipeline::finish() {
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    _isClosed = true;
+  }
+  _queueChanged.notify_all();
+  if (_renderer.joinable())
+    _renderer.join();
+  _encoders.wait();
+
+  // the raw stream keeps a slot for every number, so dropped frames are
+  // filled with the background
+  if (_raw.is_open()) {
+    try {
+      std::set<size_t> dropped;
+      {
+        std::lock_guard<std::mutex> lock(_mutex);
+        dropped.swap(_droppedNumbers);
+      }
+      for (size_t number : dropped)
+        writeRaw(number, _blank);
+    } catch (const std::exception &) {
+      std::lock_guard<std::mutex> lock(_mutex);
+      if (!_error)
+        _error = std::current_exception();
+    }
+    _raw.close();
+  }
+
+  std::lock_guard<std::mutex> lock(_mutex);
+  if (_error) {
+    std::exception_ptr error = _error;
+    _error = nullptr;
+    std::rethrow_exception(error);
+  }
+}
+
+
+// draws queued snapshots into free pictures and hands them to the encoders,
+// until the pipeline is closed and the queue is empty
+void FramePipeline::render() {
+  while (true) {
+    Frame frame;
+    Picture *pic;
+    {
+      std::unique_lock<std::mutex> lock(_mutex);
+      _queueChanged.wait(lock, [this] { return _isClosed || !_queue.empty(); });
+      if (_queue.empty())
+        return;
+
+      frame = std::move(_queue.front());
+      _queue.pop_front();
+      _pictureFreed.wait(lock, [this] { return !_freePictures.empty(); });
+      pic = _freePictures.back();
+      _freePictures.pop_back();
+    }
+    _queueChanged.notify_all();
+
+    // same size and mode, so the copy reuses the picture's buffers
+    {
+      PROFILE_SCOPE("frame.render");
+      *pic = _blank;
+      drawBodies(frame.bodies, *pic, _camera, false, _catalog);
+    }
+
+    {
+      std::lock_guard<std::mutex> lock(_mutex);
+      _spareBodies.push_back(std::move(frame.bodies));
+    }
+
+    const size_t number = frame.number;
+    _encoders.submit([this, number, pic] { encode(number, pic); });
+  }
+}
+
+
+// writes one frame and returns its picture to the pool
+void FramePipeline::encode(size_t number, Picture *pic) {
+  try {
+    PROFILE_SCOPE("frame.encode");
+    if (_raw.is_open()) {
+      writeRaw(number, *pic);
+    } else {
+      char suffix[32];
+      std::snprintf(suffix, sizeof(suffix), "%05zu.png", number);
+      const std::string filename = _options.prefix + suffix;
+
+      // frames are already encoded in parallel with each other
+      if (_options.isFastPng) {
+        PngOptions png = _options.png;
+        png.threads = 1;
+        pic->save(filename, png);
+      } else {
+        pic->save(filename);
+      }
+    }
+    _written++;
+  } catch (const std::exception &) {
+    std::lock_guard<std::mutex> lock(_mutex);
+    if (!_error)
+      _error = std::current_exception();
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    _freePictures.push_back(pic);
+  }
+  _pictureFreed.notify_one();
+}
+
+
+// Converts the picture to 8-bit RGB rows, top row first, and writes them at
+// the frame's place in the file. Every frame has the same size, so snapshots
+// arriving out of order from parallel Kepler chunks and from the backward
+// N-body sweep need no buffering
+void FramePipeline::writeRaw(size_t number, const Picture &pic) {
+  _rawBytes.resize(size_t(pic.width()) * pic.height() * 3);
+  unsigned char *out = _rawBytes.data();
+  for (int y = 0; y < pic.height(); y++) {
+    for (int x = 0; x < pic.width(); x++) {
+      const uint32_t pixel = pic.isIndexed()
+                                 ? pic.palette()[pic.indexRow(y)[x]]
+                                 : pic.row(y)[x];
+      const rgbColor color = Picture::unpack(pixel);
+      *out++ = color.r;
+      *out++ = color.g;
+      *out++ = color.b;
+    }
+  }
+
+  _raw.seekp(std::streamoff(number * _rawBytes.size()));
+  _raw.write(reinterpret_cast<const char *>(_rawBytes.data()),
+             _rawBytes.size());
+  if (!_raw)
+    throw std::runtime_error("Could not write " + _options.rawFile + "\n");
+}
@@ -0,0 +1,103 @@
+#include "../include/camera.h"
+#include "../include/coord.h"
+#include "../include/picture.h"
+#include "../include/util.h"
+#include "../include/vec.h"
+
+#include <cmath>
+#include <stdexcept>
+#include <string>
+
+
+// returns the projection with the given name, throws std::invalid_argument if
+// none
+Projection parseProjection(const std::string &name) {
+  if (name == "ortho" || name == "orthographic")
+    return Projection::Orthographic;
+  if (name == "oblique")
+    return Projection::Oblique;
+  throw std::invalid_argument("Unknown projection \"" + name + "\"");
+}
+
+
+Camera::Camera(int size, double halfWidth, const View &view)
+    : _size(size), _halfSize(size / 2), _halfWidth(halfWidth), _view(view),
+      _windowWidth(size), _windowHeight(size) {
+  if (halfWidth <= 0 || view.zoom <= 0)
+    throw std::invalid_argument("Camera needs a positive width and zoom");
+
+  const double c = std::cos(view.angle);
+  const double s = std::sin(view.angle);
+  Mat3d projection;
+  if (view.projection == Projection::Oblique) {
+    // cabinet projection, heights recede at half scale
+    projection = {{{1, 0, 0.5 * c}, {0, 1, 0.5 * s}, {0, 0, 1}}};
+  } else {
+    // the ecliptic tilted about the horizontal axis
+    projection = Mat3d::rotationX(c, s).transposed();
+  }
+  _transform = Mat3d::rotationZ(view.rotation) * projection;
+}
+
+
+void Camera::setWindow(int x, int y, int width, int height) {
+  _windowX = x;
+  _windowY = y;
+  _windowWidth = width;
+  _windowHeight = height;
+}
+
+
+// The default view reduces to x / halfWidth and -y / halfWidth scaled by half
+// the canvas, exactly, so the whole-system picture is unchanged. The results
+// are offsets from the middle of the canvas [px]
+void Camera::toCanvas(const Coord &pos, double &px, double &py) const {
+  const Vec3d picture = _transform * toVec((pos - _view.center) / M_PER_AU);
+  const double x = picture[0];
+  const double y = picture[1];
+
+  px = _halfSize * (x / _halfWidth * _view.zoom);
+  py = _halfSize * (-y / _halfWidth * _view.zoom);
+}
+
+
+// Rejects offsets more than a pixel past the window and margin, in floating
+// point, which also keeps far bodies from overflowing conversions to int
+bool Camera::isCulled(double px, double py, int margin) const {
+  const double left = _windowX - _halfSize - margin - 1;
+  const double top = _windowY - _halfSize - margin - 1;
+  return !(px > left && px < left + _windowWidth + 2 * margin + 2 &&
+           py > top && py < top + _windowHeight + 2 * margin + 2);
+}
+
+
+bool Camera::project(const Coord &pos, Point &pixel, int margin) const {
+  double px, py;
+  toCanvas(pos, px, py);
+  if (isCulled(px, py, margin))
+    return false;
+
+  // truncated toward the middle, as pixels always have been
+  const int x0 = int(px) + _halfSize - _windowX;
+  const int y0 = int(py) + _halfSize - _windowY;
+  if (x0 < -margin || y0 < -margin || x0 >= _windowWidth + margin ||
+      y0 >= _windowHeight + margin)
+    return false;
+
+  pixel = {x0, y0};
+  return true;
+}
+
+
+bool Camera::project(const Coord &pos, double &x, double &y,
+                     int margin) const {
+  double px, py;
+  toCanvas(pos, px, py);
+  if (isCulled(px, py, margin))
+    return false;
+
+  x = px + _halfSize - _windowX;
+  y = py + _halfSize - _windowY;
+  return x >= -margin && y >= -margin && x < _windowWidth + margin &&
+         y < _windowHeight + margin;
+}
@@ -0,0 +1,117 @@
+#include "../include/catalog.h"
+#include "../include/picture.h"
+#include "../include/planet.h"
+#include "../include/util.h"
+
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+
+// sets the info of body id, replacing any it had
+void Catalog::add(BodyId id, const BodyInfo &info) {
+  if (id >= _info.size()) {
+    _info.resize(id + 1);
+    _isKnown.resize(id + 1, false);
+  }
+  if (!_isKnown[id])
+    _size++;
+  _info[id] = info;
+  _isKnown[id] = true;
+}
+
+
+// info of body id, or null if there is none
+const BodyInfo *Catalog::find(BodyId id) const {
+  return id < _isKnown.size() && _isKnown[id] ? &_info[id] : nullptr;
+}
+
+
+// info of the named body, or null if there is none
+const BodyInfo *Catalog::find(const std::string &name) const {
+  BodyId id;
+  return findBodyId(name, id) ? find(id) : nullptr;
+}
+
+
+// returns the class with the given name, throws std::invalid_argument if none
+BodyClass parseBodyClass(const std::string &name) {
+  if (name == "star")
+    return BodyClass::Star;
+  if (name == "planet")
+    return BodyClass::Planet;
+  if (name == "dwarf planet")
+    return BodyClass::DwarfPlanet;
+  if (name == "moon")
+    return BodyClass::Moon;
+  if (name == "asteroid")
+    return BodyClass::Asteroid;
+  if (name == "comet")
+    return BodyClass::Comet;
+  throw std::invalid_argument("Unknown body class \"" + name + "\"");
+}
+
+
+// color used for bodies of a class that do not set one
+rgbColor defaultColor(BodyClass type) {
+  switch (type) {
+  case BodyClass::Star:
+    return {255, 245, 160};
+  case BodyClass::Planet:
+    return {200, 200, 200};
+  case BodyClass::DwarfPlanet:
+    return {170, 150, 130};
+  case BodyClass::Moon:
+    return {150, 150, 150};
+  case BodyClass::Asteroid:
+    return {120, 110, 100};
+  case BodyClass::Comet:
+    return {160, 220, 255};
+  }
+  return rgbColor();
+}
+
+
+// parses a #rrggbb color, throws std::invalid_argument if malformed
+rgbColor parseColor(const std::string &hex) {
+  if (hex.size() != 7 || hex[0] != '#' ||
+      hex.find_first_not_of("0123456789abcdefABCDEF", 1) != std::string::npos)
+    throw std::invalid_argument("Color \"" + hex + "\" is not #rrggbb");
+
+  const int value = std::stoi(hex.substr(1), nullptr, 16);
+  return {(value >> 16) & 0xff, (value >> 8) & 0xff, value & 0xff};
+}
+
+
+// index of every body by id
+std::unordered_map<BodyId, size_t>
+indexById(const std::vector<StateVector> &bodies) {
+  std::unordered_map<BodyId, size_t> indices;
+  indices.reserve(bodies.size());
+  for (size_t i = 0; i < bodies.size(); i++) {
+    indices.emplace(bodies[i].id, i);
+  }
+  return indices;
+}
+
+
+// index of the most massive body
+size_t centralIndex(const std::vector<StateVector> &bodies) {
+  return std::max_element(bodies.begin(), bodies.end(),
+                          [](const StateVector &a, const StateVector &b) {
+                            return a.mass < b.mass;
+                          }) -
+         bodies.begin();
+}
+
+
+// appends the Sun at the origin to bodies, and its info to catalog when not
+// null
+void addSun(std::vector<StateVector> &bodies, Catalog *catalog) {
+  const BodyId id = internName("sun");
+  bodies.push_back({id, Coord(), Coord(), M_SUN, R_SUN});
+  if (catalog)
+    catalog->add(id, {BodyClass::Star, defaultColor(BodyClass::Star), R_SUN});
+}
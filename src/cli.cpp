@@ -0,0 +1,276 @@
+#include "../include/animation.h"
+#include "../include/camera.h"
+#include "../include/cli.h"
+#include "../include/date.h"
+#include "../include/density.h"
+#include "../include/frame.h"
+#include "../include/io.h"
+#include "../include/png.h"
+#include "../include/profile.h"
+#include "../include/util.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+
+// returns days since J2000 epoch of a MM/DD/YYYY argument
+double parseDateArg(const std::string &arg) {
+  Date date;
+  if (!parseDate(arg, date))
+    throw std::invalid_argument("Expected MM/DD/YYYY, got \"" + arg + "\"");
+  return date.calcDaysSinceEpoch();
+}
+
+
+// parses command line arguments, throws std::invalid_argument on bad input
+Options parseArgs(int argc, char *argv[]) {
+  Options options;
+  options.threads = std::max(1u, std::thread::hardware_concurrency());
+
+  int i = 1;
+
+  // returns the value following the current flag
+  auto next = [&](const std::string &flag) -> std::string {
+    if (i + 1 >= argc)
+      throw std::invalid_argument(flag + " requires a value");
+    return argv[++i];
+  };
+
+  for (; i < argc; i++) {
+    const std::string arg = argv[i];
+
+    if (arg == "-h" || arg == "--help") {
+      options.help = true;
+    } else if (arg == "-m" || arg == "--mode") {
+      const std::string mode = next(arg);
+      if (mode == "kepler" || mode == "keplerian") {
+        options.mode = Mode::Keplerian;
+      } else if (mode == "nbody") {
+        options.mode = Mode::NBody;
+      } else {
+        throw std::invalid_argument("Unknown mode \"" + mode + "\"");
+      }
+    } else if (arg == "-d" || arg == "--date") {
+      options.dates.push_back(parseDateArg(next(arg)));
+    } else if (arg == "-r" || arg == "--range") {
+      const double start = parseDateArg(next(arg));
+      const double end = parseDateArg(next(arg));
+      const double step = std::stod(next(arg));
+      if (step <= 0)
+        throw std::invalid_argument("--range step must be positive");
+      // each date from its index, so rounding does not build up along the
+      // range
+      const double count = std::floor((end - start + 1e-9) / step);
+      for (long long k = 0; k <= count; k++) {
+        options.dates.push_back(start + double(k) * step);
+      }
+    } else if (arg == "-f" || arg == "--dates-file") {
+      const std::vector<double> dates = readDates(next(arg));
+      options.dates.insert(options.dates.end(), dates.begin(), dates.end());
+    } else if (arg == "--planets") {
+      options.planetsFile = next(arg);
+    } else if (arg == "--solutions") {
+      options.solutionsFile = next(arg);
+    } else if (arg == "-j" || arg == "--threads") {
+      const int threads = std::stoi(next(arg));
+      if (threads < 1)
+        throw std::invalid_argument("--threads must be at least 1");
+      options.threads = threads;
+    } else if (arg == "--format") {
+      const std::string format = next(arg);
+      if (format == "text") {
+        options.format = Format::Text;
+      } else if (format == "csv") {
+        options.format = Format::CSV;
+      } else if (format == "json") {
+        options.format = Format::JSON;
+      } else {
+        throw std::invalid_argument("Unknown format \"" + format + "\"");
+      }
+    } else if (arg == "--frame") {
+      options.frame = parseFrame(next(arg));
+    } else if (arg == "-o" || arg == "--output") {
+      options.outputFile = next(arg);
+    } else if (arg == "--no-render") {
+      options.render = false;
+    } else if (arg == "--size") {
+      options.pictureSize = std::stoi(next(arg));
+      if (options.pictureSize < 2)
+        throw std::invalid_argument("--size must be at least 2");
+    } else if (arg == "--center") {
+      const double x = std::stod(next(arg));
+      const double y = std::stod(next(arg));
+      options.view.center = Coord(x * M_PER_AU, y * M_PER_AU, 0.0);
+    } else if (arg == "--zoom") {
+      options.view.zoom = std::stod(next(arg));
+      if (options.view.zoom <= 0)
+        throw std::invalid_argument("--zoom must be positive");
+    } else if (arg == "--rotate") {
+      options.view.rotation = toRadians(std::stod(next(arg)));
+    } else if (arg == "--projection") {
+      options.view.projection = parseProjection(next(arg));
+    } else if (arg == "--tilt") {
+      options.view.angle = toRadians(std::stod(next(arg)));
+    } else if (arg == "--tile-rows") {
+      options.tileRows = std::stoi(next(arg));
+      if (options.tileRows < 1)
+        throw std::invalid_argument("--tile-rows must be at least 1");
+    } else if (arg == "--trails") {
+      options.trailSpacing = std::stod(next(arg));
+      if (options.trailSpacing <= 0)
+        throw std::invalid_argument("--trails must be positive");
+    } else if (arg == "--supersample") {
+      options.supersample = std::stoi(next(arg));
+      if (options.supersample < 1 || options.supersample > 8)
+        throw std::invalid_argument("--supersample must be between 1 and 8");
+    } else if (arg == "--indexed") {
+      options.isIndexed = true;
+    } else if (arg == "--png-level") {
+      options.isFastPng = true;
+      options.png.level = std::stoi(next(arg));
+      if (options.png.level < 0 || options.png.level > 9)
+        throw std::invalid_argument("--png-level must be between 0 and 9");
+    } else if (arg == "--png-filter") {
+      options.isFastPng = true;
+      options.png.filter = parsePngFilter(next(arg));
+    } else if (arg == "--frames") {
+      options.animation.prefix = next(arg);
+    } else if (arg == "--raw-video") {
+      options.animation.rawFile = next(arg);
+    } else if (arg == "--frame-queue") {
+      const int capacity = std::stoi(next(arg));
+      if (capacity < 1)
+        throw std::invalid_argument("--frame-queue must be at least 1");
+      options.animation.queueCapacity = capacity;
+    } else if (arg == "--frame-policy") {
+      options.animation.policy = parseBackpressure(next(arg));
+    } else if (arg == "--density") {
+      options.isDensity = true;
+      options.toneMap = parseToneMap(next(arg));
+    } else if (arg == "--gamma") {
+      options.gamma = std::stod(next(arg));
+      if (options.gamma <= 0)
+        throw std::invalid_argument("--gamma must be positive");
+    } else if (arg == "--compensated") {
+      options.integrator.isCompensated = true;
+    } else if (arg == "--encounters") {
+      options.integrator.encounterHillRadii = std::stod(next(arg));
+      if (options.integrator.encounterHillRadii <= 0)
+        throw std::invalid_argument("--encounters must be positive");
+    } else if (arg == "--collisions") {
+      options.integrator.collisionRadiusScale = std::stod(next(arg));
+      if (options.integrator.collisionRadiusScale <= 0)
+        throw std::invalid_argument("--collisions must be positive");
+    } else if (arg == "--eject") {
+      options.integrator.ejectionDistance = std::stod(next(arg)) * M_PER_AU;
+      if (options.integrator.ejectionDistance <= 0)
+        throw std::invalid_argument("--eject must be positive");
+    } else if (arg == "--diagnostics") {
+      options.diagnosticsFile = next(arg);
+    } else if (arg == "--diagnostics-every") {
+      options.diagnosticsInterval = std::stoi(next(arg));
+      if (options.diagnosticsInterval < 1)
+        throw std::invalid_argument("--diagnostics-every must be at least 1");
+    } else if (arg == "--serve") {
+      options.serve = true;
+    } else if (arg == "--socket") {
+      options.socketPath = next(arg);
+      options.serve = true;
+    } else if (arg == "--checkpoint") {
+      options.checkpointDays = std::stod(next(arg));
+      if (options.checkpointDays <= 0)
+        throw std::invalid_argument("--checkpoint must be positive");
+    } else if (arg == "--trace") {
+      options.traceFile = next(arg);
+      if (!isProfilingEnabled())
+        throw std::invalid_argument(
+            "--trace needs a build with profiling, make PROFILE=1");
+    } else if (arg == "--counters") {
+      options.isCounting = true;
+      if (!isProfilingEnabled())
+        throw std::invalid_argument(
+            "--counters needs a build with profiling, make PROFILE=1");
+    } else if (arg == "--test") {
+      options.test = true;
+    } else {
+      throw std::invalid_argument("Unknown argument \"" + arg + "\"");
+    }
+  }
+
+  if (options.tileRows > 0 && (options.isDensity || options.supersample > 1))
+    throw std::invalid_argument(
+        "--tile-rows cannot be combined with --density or --supersample");
+  if (options.trailSpacing > 0 && (options.isDensity || options.tileRows > 0))
+    throw std::invalid_argument(
+        "--trails cannot be combined with --density or --tile-rows");
+
+  return options;
+}
+
+
+// displays accepted command line arguments
+void printUsage(const std::string &program) {
+  std::cout
+      << "Usage: " << program << " [options]\n\n"
+      << "Prompts for a date when none is given.\n\n"
+      << "  -m, --mode kepler|nbody     approximation to use (default nbody)\n"
+      << "  -d, --date MM/DD/YYYY       add a query date, repeatable\n"
+      << "  -r, --range START END STEP  add every STEP days from START to END\n"
+      << "  -f, --dates-file FILE       add one MM/DD/YYYY date per line\n"
+      << "      --planets FILE          orbital elements (default planets.json)\n"
+      << "      --solutions FILE        state vectors (default solutions.json)\n"
+      << "  -j, --threads N             worker threads for batch queries\n"
+      << "      --format text|csv|json  output format (default text)\n"
+      << "      --frame NAME            output frame only: heliocentric\n"
+      << "                              (default), barycentric, democratic or\n"
+      << "                              jacobi, integration stays barycentric\n"
+      << "  -o, --output FILE           PNG to render (default result.png)\n"
+      << "      --no-render             skip drawing and saving the PNG\n"
+      << "      --size N                picture width and height (default 2000)\n"
+      << "      --center X Y            AU from the Sun to center the view on\n"
+      << "      --zoom Z                magnify the whole-system view Z times\n"
+      << "      --rotate DEG            turn the picture counterclockwise\n"
+      << "      --projection NAME       ortho (default) or oblique\n"
+      << "      --tilt DEG              ortho: tilt of the ecliptic, oblique:\n"
+      << "                              direction heights are drawn in\n"
+      << "      --tile-rows N           render and save N rows at a time\n"
+      << "      --trails PX             draw paths as anti-aliased lines between\n"
+      << "                              samples PX pixels apart\n"
+      << "      --supersample N         draw at N times the size, then average\n"
+      << "                              down to anti-alias\n"
+      << "      --indexed               draw with a palette, save paletted PNG\n"
+      << "      --png-level N           fast PNG encoding, 0 (stored) to 9\n"
+      << "      --png-filter NAME       none, sub, up (default), average, paeth\n"
+      << "                              or adaptive, implies fast encoding\n"
+      << "      --frames PREFIX         write every date as PREFIXNNNNN.png\n"
+      << "      --raw-video FILE        write every date as raw RGB24 frames\n"
+      << "      --frame-queue N         frames waiting to render (default 8)\n"
+      << "      --frame-policy NAME     block (default) or drop frames when\n"
+      << "                              the queue is full\n"
+      << "      --density log|gamma     draw paths as tone mapped density\n"
+      << "      --gamma G               exponent of gamma density (default 2.2)\n"
+      << "      --test                  compare results with solutions file\n"
+      << "      --compensated           Kahan summation of N-body updates\n"
+      << "      --encounters HILL       Bulirsch-Stoer for bodies within HILL\n"
+      << "                              Hill radii of each other\n"
+      << "      --collisions SCALE      merge bodies whose radii, times SCALE,\n"
+      << "                              overlap\n"
+      << "      --eject AU              remove bodies farther than AU from the\n"
+      << "                              central body\n"
+      << "      --diagnostics FILE      write N-body invariants as CSV\n"
+      << "      --diagnostics-every N   steps between invariants (default 4)\n"
+      << "      --serve                 answer queries on stdin/stdout\n"
+      << "      --socket PATH           answer queries on a Unix socket\n"
+      << "      --checkpoint DAYS       days between cached N-body states\n"
+      << "      --trace FILE            write profiled scopes as a Chrome trace\n"
+      << "                              (make PROFILE=1 builds)\n"
+      << "      --counters              count cycles, cache and branch misses\n"
+      << "                              of the force pass, stages and drawing\n"
+      << "                              (make PROFILE=1 builds)\n"
+      << "  -h, --help                  display this message\n";
+}
@@ -0,0 +1,104 @@
+#include "../include/catalog.h"
+#include "../include/collision.h"
+#include "../include/nBodyApprox.h"
+#include "../include/planet.h"
+#include "../include/spatialHash.h"
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+
+CollisionSolver::CollisionSolver(double radiusScale, double ejectionDistance)
+    : _radiusScale(radiusScale), _ejectionDistance(ejectionDistance) {}
+
+
+// combines absorbed into survivor, conserving mass and momentum
+void CollisionSolver::merge(StateVector &survivor,
+                            const StateVector &absorbed) const {
+  const double mass = survivor.mass + absorbed.mass;
+  const double w1 = survivor.mass / mass;
+  const double w2 = absorbed.mass / mass;
+
+  survivor.pos = survivor.pos * w1 + absorbed.pos * w2;
+  survivor.vel = survivor.vel * w1 + absorbed.vel * w2;
+  survivor.radius = std::cbrt(survivor.radius * survivor.radius *
+                                  survivor.radius +
+                              absorbed.radius * absorbed.radius *
+                                  absorbed.radius);
+  survivor.mass = mass;
+}
+
+
+bool CollisionSolver::apply(std::vector<StateVector> &bodies,
+                            std::vector<Compensation> *compensation) {
+  if (bodies.size() < 2)
+    return false;
+
+  const size_t c = centralIndex(bodies);
+
+  _isRemoved.assign(bodies.size(), false);
+  bool isAnyRemoved = false;
+
+  if (_ejectionDistance > 0.0) {
+    const double limit = _ejectionDistance * _ejectionDistance;
+    for (size_t i = 0; i < bodies.size(); i++) {
+      if (i != c && bodies[i].pos.magSquared(bodies[c].pos) > limit) {
+        _isRemoved[i] = true;
+        isAnyRemoved = true;
+        _ejectionCount++;
+      }
+    }
+  }
+
+  if (_radiusScale > 0.0) {
+    double cellSize = 0.0;
+    for (const StateVector &body : bodies) {
+      cellSize = std::max(cellSize, 2.0 * _radiusScale * body.radius);
+    }
+
+    if (cellSize > 0.0) {
+      _hash.build(bodies, cellSize);
+      _hash.findPairs(
+          bodies,
+          [&](size_t i, size_t j) {
+            return _radiusScale * (bodies[i].radius + bodies[j].radius);
+          },
+          _pairs);
+
+      for (const auto &pair : _pairs) {
+        size_t survivor = pair.first, absorbed = pair.second;
+        if (_isRemoved[survivor] || _isRemoved[absorbed])
+          continue;
+
+        // the central body always survives, otherwise the heavier one
+        if (absorbed == c ||
+            (survivor != c && bodies[absorbed].mass > bodies[survivor].mass))
+          std::swap(survivor, absorbed);
+
+        merge(bodies[survivor], bodies[absorbed]);
+        _isRemoved[absorbed] = true;
+        isAnyRemoved = true;
+        _mergerCount++;
+
+        // round-off of the separate updates no longer applies
+        if (compensation)
+          (*compensation)[survivor] = Compensation();
+      }
+    }
+  }
+
+  if (!isAnyRemoved)
+    return false;
+
+  // removing from the back means every moved body is kept
+  for (size_t i = bodies.size(); i-- > 0;) {
+    if (!_isRemoved[i])
+      continue;
+    swapRemove(bodies, i);
+    if (compensation)
+      swapRemove(*compensation, i);
+  }
+
+  return true;
+}
@@ -0,0 +1,170 @@
+#include "../include/counters.h"
+
+#include <cerrno>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+
+const char *counterName(CounterEvent event) {
+  switch (event) {
+  case CounterEvent::Cycles:
+    return "cycles";
+  case CounterEvent::Instructions:
+    return "instructions";
+  case CounterEvent::CacheReferences:
+    return "cache-references";
+  case CounterEvent::CacheMisses:
+    return "cache-misses";
+  case CounterEvent::Branches:
+    return "branches";
+  case CounterEvent::BranchMisses:
+    return "branch-misses";
+  case CounterEvent::TaskClock:
+    return "task-clock";
+  case CounterEvent::PageFaults:
+    return "page-faults";
+  }
+  return "unknown";
+}
+
+
+CounterValues &CounterValues::operator+=(const CounterValues &other) {
+  for (size_t e = 0; e < kCounterEvents; e++) {
+    counts[e] += other.counts[e];
+    isCounted[e] = isCounted[e] || other.isCounted[e];
+  }
+  return *this;
+}
+
+
+CounterValues CounterValues::operator-(const CounterValues &start) const {
+  CounterValues difference = *this;
+  for (size_t e = 0; e < kCounterEvents; e++) {
+    difference.counts[e] = counts[e] >= start.counts[e]
+                               ? counts[e] - start.counts[e]
+                               : 0; // scaling can step back slightly
+  }
+  return difference;
+}
+
+
+double counterRatio(const CounterValues &values, CounterEvent numerator,
+                    CounterEvent denominator) {
+  if (!values.has(numerator) || !values.has(denominator) ||
+      values[denominator] == 0)
+    return std::nan("");
+  return double(values[numerator]) / values[denominator];
+}
+
+
+#ifdef __linux__
+
+// perf_event_open type and config of every event, in CounterEvent order
+const struct {
+  uint32_t type;
+  uint64_t config;
+} kEventConfigs[kCounterEvents] = {
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_REFERENCES},
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES},
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_INSTRUCTIONS},
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES},
+    {PERF_TYPE_SOFTWARE, PERF_COUNT_SW_TASK_CLOCK},
+    {PERF_TYPE_SOFTWARE, PERF_COUNT_SW_PAGE_FAULTS},
+};
+
+
+CounterGroup::CounterGroup() {
+  _fds.fill(-1);
+  std::string missing;
+  int firstErrno = 0;
+
+  // the first event opened leads the group, the rest join it
+  for (size_t e = 0; e < kCounterEvents; e++) {
+    perf_event_attr attr;
+    std::memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = kEventConfigs[e].type;
+    attr.config = kEventConfigs[e].config;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED |
+                       PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+    _fds[e] = syscall(SYS_perf_event_open, &attr, 0, -1, _leader, 0);
+    if (_fds[e] < 0) {
+      if (!firstErrno)
+        firstErrno = errno;
+      missing += (missing.empty() ? "" : ", ") +
+                 std::string(counterName(CounterEvent(e)));
+    } else if (_leader < 0) {
+      _leader = _fds[e];
+    }
+  }
+
+  if (!missing.empty())
+    _error = "could not count " + missing + " (" + std::strerror(firstErrno) +
+             ")";
+}
+
+
+CounterGroup::~CounterGroup() {
+  for (const int fd : _fds) {
+    if (fd >= 0)
+      close(fd);
+  }
+}
+
+
+CounterValues CounterGroup::read() const {
+  CounterValues values;
+  if (_leader < 0)
+    return values;
+
+  // number of events, time enabled, time running, then every event's value
+  uint64_t data[3 + kCounterEvents];
+  if (::read(_leader, data, sizeof(data)) < ssize_t(3 * sizeof(uint64_t)))
+    return values;
+
+  const double scale =
+      data[2] > 0 ? double(data[1]) / double(data[2]) : 0.0;
+  size_t next = 3;
+  for (size_t e = 0; e < kCounterEvents && next < 3 + data[0]; e++) {
+    if (_fds[e] < 0)
+      continue;
+    values.counts[e] = std::llround(data[next++] * scale);
+    values.isCounted[e] = true;
+  }
+  return values;
+}
+
+#else
+
+CounterGroup::CounterGroup() {
+  _fds.fill(-1);
+  _error = "counters need perf_event_open, which only Linux has";
+}
+
+
+CounterGroup::~CounterGroup() = default;
+
+
+CounterValues CounterGroup::read() const { return CounterValues(); }
+
+#endif
+
+
+CounterGroup &threadCounters() {
+  thread_local CounterGroup group;
+  return group;
+}
@@ -0,0 +1,140 @@
+#include "../include/camera.h"
+#include "../include/density.h"
+#include "../include/helpers.h"
+#include "../include/picture.h"
+#include "../include/planet.h"
+#include "../include/profile.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+
+// returns the tone map with the given name, throws std::invalid_argument if
+// none
+ToneMap parseToneMap(const std::string &name) {
+  if (name == "log")
+    return ToneMap::Log;
+  if (name == "gamma")
+    return ToneMap::Gamma;
+  throw std::invalid_argument("Unknown tone map \"" + name + "\"");
+}
+
+
+DensityMap::DensityMap(const Camera &camera)
+    : _camera(camera), _size(camera.size()) {}
+
+
+// the calling thread's tile, created on its first use
+std::vector<uint32_t> &DensityMap::tile() {
+  std::lock_guard<std::mutex> lock(_mutex);
+  std::vector<uint32_t> &counts = _tiles[std::this_thread::get_id()];
+  if (counts.empty())
+    counts.resize(size_t(_size) * _size);
+  return counts;
+}
+
+
+// bins bodies in [begin, end) into counts, dropping any off the picture
+void DensityMap::count(const StateVector *begin, const StateVector *end,
+                       std::vector<uint32_t> &counts) const {
+  Point p;
+  for (const StateVector *b = begin; b != end; b++) {
+    if (_camera.project(b->pos, p))
+      counts[size_t(p.y) * _size + p.x]++;
+  }
+}
+
+
+// Counts every body into the calling thread's tile. Safe to call from several
+// threads at once
+void DensityMap::accumulate(const std::vector<StateVector> &bodies) {
+  PROFILE_SCOPE("density.accumulate");
+  count(bodies.data(), bodies.data() + bodies.size(), tile());
+}
+
+
+// Counts bodies split evenly across threadCount threads
+void DensityMap::accumulate(const std::vector<StateVector> &bodies,
+                            unsigned threadCount) {
+  threadCount = std::max(1u, std::min<unsigned>(threadCount, bodies.size()));
+  const size_t chunkSize = (bodies.size() + threadCount - 1) / threadCount;
+
+  auto worker = [&](size_t begin, size_t end) {
+    count(bodies.data() + begin, bodies.data() + end, tile());
+  };
+
+  std::vector<std::thread> workers;
+  for (size_t begin = chunkSize; begin < bodies.size(); begin += chunkSize) {
+    workers.emplace_back(worker, begin, std::min(begin + chunkSize,
+                                                 bodies.size()));
+  }
+
+  // the calling thread takes the first chunk
+  worker(0, std::min(chunkSize, bodies.size()));
+
+  for (std::thread &t : workers) {
+    t.join();
+  }
+}
+
+
+// Merges every tile and blends color over pic by each pixel's tone mapped
+// count
+void DensityMap::render(Picture &pic, rgbColor color, ToneMap mapping,
+                        double gamma) const {
+  PROFILE_SCOPE("density.render");
+  std::lock_guard<std::mutex> lock(_mutex);
+  if (_tiles.empty())
+    return;
+
+  std::vector<uint32_t> counts(size_t(_size) * _size);
+  for (const auto &entry : _tiles) {
+    const std::vector<uint32_t> &tileCounts = entry.second;
+    for (size_t k = 0; k < counts.size(); k++) {
+      counts[k] += tileCounts[k];
+    }
+  }
+
+  const uint32_t densest = *std::max_element(counts.begin(), counts.end());
+  if (densest == 0)
+    return;
+
+  const double logScale = 1.0 / std::log1p(double(densest));
+  auto intensity = [&](uint32_t n) {
+    return mapping == ToneMap::Log
+               ? std::log1p(double(n)) * logScale
+               : std::pow(double(n) / densest, 1.0 / gamma);
+  };
+
+  // blending makes more colors than a palette holds
+  pic.setIndexed(false);
+
+  const int height = std::min(_size, pic.height());
+  const int width = std::min(_size, pic.width());
+  const double target[3] = {double(color.r), double(color.g), double(color.b)};
+
+  for (int y = 0; y < height; y++) {
+    uint32_t *row = pic.row(y);
+    const uint32_t *rowCounts = counts.data() + size_t(y) * _size;
+    for (int x = 0; x < width; x++) {
+      if (rowCounts[x] == 0)
+        continue;
+
+      const double v = intensity(rowCounts[x]);
+      unsigned char rgba[4];
+      std::memcpy(rgba, &row[x], sizeof(rgba));
+      for (int c = 0; c < 3; c++) {
+        rgba[c] = static_cast<unsigned char>(
+            std::lround(rgba[c] + (target[c] - rgba[c]) * v));
+      }
+      std::memcpy(&row[x], rgba, sizeof(rgba));
+    }
+  }
+}
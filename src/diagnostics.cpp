@@ -0,0 +1,100 @@
+#include "../include/diagnostics.h"
+#include "../include/coord.h"
+#include "../include/planet.h"
+#include "../include/util.h"
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <iomanip>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+
+Diagnostics::Diagnostics(int dt, int interval)
+    : _dt(dt), _interval(std::max(1, interval)) {}
+
+
+// called once per step with the bodies at the start of the step
+void Diagnostics::onStep(const std::vector<StateVector> &bodies,
+                         double potentialEnergy) {
+  if (isDue()) {
+    _samples.push_back(
+        calcInvariants(bodies, potentialEnergy, double(_stepsSeen) * _dt));
+  }
+  _stepsSeen++;
+}
+
+
+// Invariants of bodies given the potential energy of the system
+Invariants calcInvariants(const std::vector<StateVector> &bodies,
+                          double potentialEnergy, double seconds) {
+  Invariants invariants = {seconds, potentialEnergy, Coord(), Coord(),
+                           Coord(), 0.0};
+
+  for (const StateVector &b : bodies) {
+    const Coord &r = b.pos;
+    const Coord &v = b.vel;
+
+    invariants.energy += 0.5 * b.mass * normSquared(v);
+    invariants.angularMomentum +=
+        Coord(r.y * v.z - r.z * v.y, r.z * v.x - r.x * v.z,
+              r.x * v.y - r.y * v.x) *
+        b.mass;
+    invariants.momentum.addScaled(v, b.mass);
+    invariants.barycenter.addScaled(r, b.mass);
+    invariants.mass += b.mass;
+  }
+
+  invariants.barycenter = invariants.barycenter / invariants.mass;
+  return invariants;
+}
+
+
+// writes the time series with drift relative to the sample at zero seconds,
+// and returns the largest relative energy drift
+double writeInvariants(const std::string &filename,
+                       const std::vector<Invariants> &samples) {
+  std::ofstream fileStream(filename);
+  if (!fileStream)
+    throw std::runtime_error("Could not open " + filename + "\n");
+
+  auto reference = std::find_if(
+      samples.begin(), samples.end(),
+      [](const Invariants &sample) { return sample.seconds == 0.0; });
+  if (reference == samples.end())
+    throw std::domain_error("No invariants sampled at the initial state\n");
+
+  const Invariants &initial = *reference;
+  const Coord barycenterVelocity = initial.momentum / initial.mass;
+  const double angularMomentum = norm(initial.angularMomentum);
+  double maxEnergyDrift = 0.0;
+
+  fileStream << "days,energy,lx,ly,lz,energy_drift,angular_momentum_drift,"
+                "barycenter_drift\n"
+             << std::scientific << std::setprecision(12);
+
+  for (const Invariants &sample : samples) {
+    const double energyDrift =
+        std::abs((sample.energy - initial.energy) / initial.energy);
+    const double angularMomentumDrift =
+        std::sqrt(sample.angularMomentum.magSquared(initial.angularMomentum)) /
+        angularMomentum;
+
+    // an isolated barycenter moves in a straight line with the momentum
+    const Coord expectedBarycenter =
+        initial.barycenter + barycenterVelocity * sample.seconds;
+
+    maxEnergyDrift = std::max(maxEnergyDrift, energyDrift);
+
+    fileStream << sample.seconds / SEC_PER_DAY << ',' << sample.energy << ','
+               << sample.angularMomentum.x << ',' << sample.angularMomentum.y
+               << ',' << sample.angularMomentum.z << ',' << energyDrift << ','
+               << angularMomentumDrift << ','
+               << std::sqrt(sample.barycenter.magSquared(expectedBarycenter))
+               << '\n';
+  }
+
+  return maxEnergyDrift;
+}
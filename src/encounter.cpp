@@ -0,0 +1,257 @@
+#include "../include/catalog.h"
+#include "../include/encounter.h"
+#include "../include/nBodyApprox.h"
+#include "../include/planet.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <utility>
+#include <vector>
+
+
+EncounterSolver::EncounterSolver(double hillRadii, double tolerance)
+    : _hillRadii(hillRadii), _tolerance(tolerance) {}
+
+
+// Squared encounter radius of every body, its scaled Hill radius about the
+// central body, and negative for the central body so it never encounters
+// anything. The mass term only changes with a merger, so it is kept
+const std::vector<double> &
+EncounterSolver::updateRadii(const std::vector<StateVector> &bodies) {
+  _radii.resize(bodies.size());
+  if (bodies.empty())
+    return _radii;
+
+  const size_t c = centralIndex(bodies);
+  const double centralMass = bodies[c].mass;
+  if (_factors.size() != bodies.size() || centralMass != _centralMass)
+    _factorMasses.assign(bodies.size(), -1.0);
+  _factors.resize(bodies.size());
+  _centralMass = centralMass;
+
+  for (size_t i = 0; i < bodies.size(); i++) {
+    if (bodies[i].mass != _factorMasses[i]) {
+      const double factor =
+          _hillRadii * std::cbrt(bodies[i].mass / (3.0 * centralMass));
+      _factors[i] = factor * factor;
+      _factorMasses[i] = bodies[i].mass;
+    }
+    _radii[i] =
+        i == c ? -1.0 : _factors[i] * bodies[i].pos.magSquared(bodies[c].pos);
+  }
+  return _radii;
+}
+
+
+// Replaces the updated state of every body in one of the pairs the force pass
+// found with a Bulirsch-Stoer step of dt seconds from bodies. Returns the
+// indices of the bodies replaced
+const std::vector<size_t> &
+EncounterSolver::resolve(const std::vector<StateVector> &bodies,
+                         std::vector<StateVector> &updatedBodies, int dt) {
+  _resolved.clear();
+  if (_pairs.empty())
+    return _resolved;
+  _encounterCount += _pairs.size();
+
+  // bodies linked by a chain of encounters are integrated as one group
+  _parents.resize(bodies.size());
+  for (size_t i = 0; i < bodies.size(); i++) {
+    _parents[i] = i;
+  }
+  auto root = [this](size_t i) {
+    while (_parents[i] != i) {
+      i = _parents[i] = _parents[_parents[i]];
+    }
+    return i;
+  };
+  for (const auto &pair : _pairs) {
+    _parents[root(pair.first)] = root(pair.second);
+    _resolved.push_back(pair.first);
+    _resolved.push_back(pair.second);
+  }
+  std::sort(_resolved.begin(), _resolved.end());
+  _resolved.erase(std::unique(_resolved.begin(), _resolved.end()),
+                  _resolved.end());
+
+  _work = bodies;
+  _isInGroup.assign(bodies.size(), false);
+
+  std::vector<bool> isDone(bodies.size(), false);
+  std::vector<size_t> group;
+  GroupState y;
+
+  for (const size_t first : _resolved) {
+    if (isDone[root(first)])
+      continue;
+    isDone[root(first)] = true;
+
+    group.clear();
+    for (const size_t i : _resolved) {
+      if (root(i) == root(first))
+        group.push_back(i);
+    }
+
+    y.resize(6 * group.size());
+    for (size_t k = 0; k < group.size(); k++) {
+      _isInGroup[group[k]] = true;
+      const StateVector &b = bodies[group[k]];
+      y[6 * k] = b.pos.x;
+      y[6 * k + 1] = b.pos.y;
+      y[6 * k + 2] = b.pos.z;
+      y[6 * k + 3] = b.vel.x;
+      y[6 * k + 4] = b.vel.y;
+      y[6 * k + 5] = b.vel.z;
+    }
+
+    _evaluationsLeft = kMaxEvaluations;
+    bulirschStoer(group, y, dt, 0);
+
+    for (size_t k = 0; k < group.size(); k++) {
+      StateVector &b = updatedBodies[group[k]];
+      b.pos = {y[6 * k], y[6 * k + 1], y[6 * k + 2]};
+      b.vel = {y[6 * k + 3], y[6 * k + 4], y[6 * k + 5]};
+
+      // later groups see the other bodies where the regular step starts
+      _work[group[k]] = bodies[group[k]];
+      _isInGroup[group[k]] = false;
+    }
+  }
+
+  return _resolved;
+}
+
+
+// Velocities and accelerations of the group, every other body held where it
+// was at the start of the step. Each group body feels every other body, and
+// pairs inside the group are visited once with the force applied to both
+void EncounterSolver::derivative(const std::vector<size_t> &group,
+                                 const GroupState &y, GroupState &dydt) {
+  for (size_t k = 0; k < group.size(); k++) {
+    StateVector &b = _work[group[k]];
+    b.pos = {y[6 * k], y[6 * k + 1], y[6 * k + 2]};
+    b.vel = {y[6 * k + 3], y[6 * k + 4], y[6 * k + 5]};
+  }
+
+  _groupAcc.assign(group.size(), Coord());
+  Coord ignored;
+  for (size_t k = 0; k < group.size(); k++) {
+    const StateVector &b = _work[group[k]];
+    for (size_t i = 0; i < _work.size(); i++) {
+      if (!_isInGroup[i])
+        calcAcc(b, _work[i], _groupAcc[k], ignored);
+    }
+    for (size_t l = k + 1; l < group.size(); l++) {
+      calcAcc(b, _work[group[l]], _groupAcc[k], _groupAcc[l]);
+    }
+  }
+
+  dydt.resize(y.size());
+  for (size_t k = 0; k < group.size(); k++) {
+    const Coord &acc = _groupAcc[k];
+    dydt[6 * k] = y[6 * k + 3];
+    dydt[6 * k + 1] = y[6 * k + 4];
+    dydt[6 * k + 2] = y[6 * k + 5];
+    dydt[6 * k + 3] = acc.x;
+    dydt[6 * k + 4] = acc.y;
+    dydt[6 * k + 5] = acc.z;
+  }
+}
+
+
+// Modified midpoint method: the given number of substeps spanning h seconds
+void EncounterSolver::modifiedMidpoint(const std::vector<size_t> &group,
+                                       const GroupState &y, double h,
+                                       int substeps, GroupState &result) {
+  const double substep = h / substeps;
+  _evaluationsLeft -= substeps + 1;
+  GroupState previous = y;
+  GroupState current(y.size());
+  GroupState dydt;
+
+  derivative(group, y, dydt);
+  for (size_t i = 0; i < y.size(); i++) {
+    current[i] = y[i] + substep * dydt[i];
+  }
+
+  for (int m = 1; m < substeps; m++) {
+    derivative(group, current, dydt);
+    for (size_t i = 0; i < y.size(); i++) {
+      const double next = previous[i] + 2.0 * substep * dydt[i];
+      previous[i] = current[i];
+      current[i] = next;
+    }
+  }
+
+  derivative(group, current, dydt);
+  result.resize(y.size());
+  for (size_t i = 0; i < y.size(); i++) {
+    result[i] = 0.5 * (current[i] + previous[i] + substep * dydt[i]);
+  }
+}
+
+
+// Advances y by h seconds, extrapolating modified midpoint results to zero
+// substep size. Halves the step when the extrapolation does not converge,
+// until the depth or the group's evaluation budget runs out, and then takes
+// the best extrapolation
+void EncounterSolver::bulirschStoer(const std::vector<size_t> &group,
+                                    GroupState &y, double h, int depth) {
+  const int maxColumns = 8;
+  const int maxDepth = 10;
+
+  // Absolute plus relative tolerance. The absolute part is relative to the
+  // size of the body's whole position or velocity vector, so a component
+  // passing through zero still converges
+  GroupState scale(y.size());
+  for (size_t i = 0; i < y.size(); i += 3) {
+    const double size =
+        std::sqrt(y[i] * y[i] + y[i + 1] * y[i + 1] + y[i + 2] * y[i + 2]);
+    for (size_t d = i; d < i + 3; d++) {
+      scale[d] = _tolerance * (size + std::abs(y[d])) +
+                 std::numeric_limits<double>::min();
+    }
+  }
+
+  std::vector<GroupState> table(maxColumns);
+  std::vector<GroupState> previousRow;
+
+  for (int k = 0; k < maxColumns; k++) {
+    const int substeps = 2 * (k + 1);
+    modifiedMidpoint(group, y, h, substeps, table[0]);
+
+    // Richardson extrapolation in the square of the substep size
+    for (int j = 1; j <= k; j++) {
+      const double ratio = double(substeps) / (2 * (k - j + 1));
+      const double factor = 1.0 / (ratio * ratio - 1.0);
+      table[j].resize(y.size());
+      for (size_t i = 0; i < y.size(); i++) {
+        table[j][i] = table[j - 1][i] +
+                      (table[j - 1][i] - previousRow[j - 1][i]) * factor;
+      }
+    }
+
+    if (k > 0) {
+      double error = 0.0;
+      for (size_t i = 0; i < y.size(); i++) {
+        error = std::max(error,
+                         std::abs(table[k][i] - table[k - 1][i]) / scale[i]);
+      }
+      if (error < 1.0 || _evaluationsLeft <= 0) {
+        y = table[k];
+        return;
+      }
+    }
+
+    previousRow.assign(table.begin(), table.begin() + k + 1);
+  }
+
+  if (depth >= maxDepth) {
+    y = table[maxColumns - 1];
+    return;
+  }
+
+  bulirschStoer(group, y, h / 2, depth + 1);
+  bulirschStoer(group, y, h / 2, depth + 1);
+}
@@ -0,0 +1,86 @@
+#include "../include/catalog.h"
+#include "../include/ephemeris.h"
+#include "../include/frame.h"
+#include "../include/json.h"
+#include "../include/keplerianApprox.h"
+#include "../include/nBodyApprox.h"
+#include "../include/planet.h"
+#include "../include/util.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <map>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <vector>
+
+
+Ephemeris::Ephemeris(const std::string &planetsFile,
+                     const std::string &solutionsFile, double checkpointDays)
+    : _checkpointSteps(std::max(1, int(std::round(checkpointDays * 4)))) {
+
+  populatePlanets(_elements, _bodies, planetsFile);
+  addSun(_bodies);
+
+  // Data from J2000 epoch, integrated about the center of mass
+  std::vector<StateVector> initialBodies = _bodies;
+  populateStateVectors(initialBodies, solutionsFile);
+  toFrame(initialBodies, Frame::Barycentric);
+  _checkpoints.emplace(0, initialBodies);
+}
+
+
+// One-body approximation at the given epoch
+std::vector<StateVector> Ephemeris::keplerian(double daysSinceEpoch) const {
+  std::vector<StateVector> bodies = _bodies;
+  keplerianApprox(_elements, bodies, daysSinceEpoch);
+  return bodies;
+}
+
+
+// N-body model at the given epoch, safe to call from several threads
+std::vector<StateVector> Ephemeris::nBody(double daysSinceEpoch) {
+  const int direction = daysSinceEpoch < 0 ? -1 : 1;
+  const int dt = direction * SEC_PER_DAY / 4; // 6-hours
+  const double exactSteps = SEC_PER_DAY * std::abs(daysSinceEpoch) / abs(dt);
+  const int target = direction * int(std::floor(exactSteps));
+
+  // nearest checkpoint between J2000 and the target
+  int step;
+  std::vector<StateVector> bodies;
+  {
+    std::shared_lock<std::shared_mutex> lock(_mutex);
+    auto it = direction > 0 ? std::prev(_checkpoints.upper_bound(target))
+                            : _checkpoints.lower_bound(target);
+    step = it->first;
+    bodies = it->second;
+  }
+
+  // integrate to the target, storing every checkpoint passed on the way
+  while (step != target) {
+    const int nextCheckpoint =
+        (step / _checkpointSteps + direction) * _checkpointSteps;
+    const bool reachesCheckpoint = std::abs(nextCheckpoint) <= std::abs(target);
+    const int next = reachesCheckpoint ? nextCheckpoint : target;
+
+    integrate(bodies, std::abs(next - step), dt);
+    step = next;
+
+    if (reachesCheckpoint) {
+      std::unique_lock<std::shared_mutex> lock(_mutex);
+      _checkpoints.emplace(step, bodies);
+    }
+  }
+
+  // land between grid points without snapping to them
+  return DenseIntegrator(bodies, dt).at(exactSteps - std::floor(exactSteps));
+}
+
+
+// number of integrated states held in memory
+size_t Ephemeris::checkpointCount() const {
+  std::shared_lock<std::shared_mutex> lock(_mutex);
+  return _checkpoints.size();
+}
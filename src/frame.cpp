@@ -0,0 +1,101 @@
+#include "../include/frame.h"
+#include "../include/catalog.h"
+#include "../include/coord.h"
+#include "../include/planet.h"
+
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+
+// returns the frame with the given name, throws std::invalid_argument if none
+Frame parseFrame(const std::string &name) {
+  if (name == "heliocentric")
+    return Frame::Heliocentric;
+  if (name == "barycentric")
+    return Frame::Barycentric;
+  if (name == "democratic")
+    return Frame::Democratic;
+  if (name == "jacobi")
+    return Frame::Jacobi;
+  throw std::invalid_argument("Unknown frame \"" + name + "\"");
+}
+
+
+// mass weighted mean position and velocity of every body
+StateVector centerOfMass(const std::vector<StateVector> &bodies) {
+  StateVector center = {0, Coord(), Coord(), 0.0};
+  for (const StateVector &b : bodies) {
+    center.pos.addScaled(b.pos, b.mass);
+    center.vel.addScaled(b.vel, b.mass);
+    center.mass += b.mass;
+  }
+  center.pos = center.pos / center.mass;
+  center.vel = center.vel / center.mass;
+  return center;
+}
+
+
+// converts state vectors from any inertial frame into frame, in place
+void toFrame(std::vector<StateVector> &bodies, Frame frame) {
+  if (bodies.empty())
+    return;
+
+  const size_t c = centralIndex(bodies);
+  const StateVector center = centerOfMass(bodies);
+  const Coord centralPos = bodies[c].pos;
+  const Coord centralVel = bodies[c].vel;
+
+  switch (frame) {
+  case Frame::Heliocentric:
+    for (StateVector &b : bodies) {
+      b.pos -= centralPos;
+      b.vel -= centralVel;
+    }
+    break;
+
+  case Frame::Barycentric:
+    for (StateVector &b : bodies) {
+      b.pos -= center.pos;
+      b.vel -= center.vel;
+    }
+    break;
+
+  case Frame::Democratic:
+    for (StateVector &b : bodies) {
+      b.pos -= centralPos;
+      b.vel -= center.vel;
+    }
+    bodies[c].pos = center.pos;
+    bodies[c].vel = center.vel;
+    break;
+
+  case Frame::Jacobi: {
+    // running center of mass of the central body and every body before
+    Coord interiorPos = centralPos;
+    Coord interiorVel = centralVel;
+    double interiorMass = bodies[c].mass;
+
+    for (size_t i = 0; i < bodies.size(); i++) {
+      if (i == c)
+        continue;
+      StateVector &b = bodies[i];
+      const Coord pos = b.pos;
+      const Coord vel = b.vel;
+      const double mass = interiorMass + b.mass;
+
+      b.pos -= interiorPos;
+      b.vel -= interiorVel;
+
+      interiorPos = (interiorPos * interiorMass + pos * b.mass) / mass;
+      interiorVel = (interiorVel * interiorMass + vel * b.mass) / mass;
+      interiorMass = mass;
+    }
+    bodies[c].pos = center.pos;
+    bodies[c].vel = center.vel;
+    break;
+  }
+  }
+}
+
@@ -1,69 +1,42 @@
+#include "../include/camera.h"
+#include "../include/catalog.h"
+#include "../include/helpers.h"
 #include "../include/picture.h"
 #include "../include/planet.h"
+#include "../include/profile.h"
 #include "../include/util.h"
 
 #include <cmath>
 #include <vector>
 
 const rgbColor cPath = {61, 23, 193};
-const rgbColor cSun = {255, 245, 160};
-const rgbColor cMercury = {200, 200, 200};
-const rgbColor cVenus = {240, 200, 170};
-const rgbColor cEarth = {100, 180, 255};
-const rgbColor cMars = {255, 110, 90};
-const rgbColor cJupiter = {230, 190, 140};
-const rgbColor cSaturn = {220, 200, 160};
-const rgbColor cUranus = {180, 220, 220};
-const rgbColor cNeptune = {90, 140, 200};
 
 void drawBodies(const std::vector<StateVector> &bodies, Picture &pic,
-                size_t systemSize, bool isPath = true) {
-
-  const static int center = pic.width() / 2;
-
-  auto drawPlanet = [&pic](const std::string &name, int x, int y) {
-    rgbColor planetColor;
-    if (name == "sun") {
-      planetColor = cSun;
-    } else if (name == "mercury") {
-      planetColor = cMercury;
-    } else if (name == "venus") {
-      planetColor = cVenus;
-    } else if (name == "earth") {
-      planetColor = cEarth;
-    } else if (name == "mars") {
-      planetColor = cMars;
-    } else if (name == "jupiter") {
-      planetColor = cJupiter;
-    } else if (name == "saturn") {
-      planetColor = cSaturn;
-    } else if (name == "uranus") {
-      planetColor = cUranus;
-    } else if (name == "neptune") {
-      planetColor = cNeptune;
-    }
-
-    // Draw 9x9 square
-    for (int i = -1; i <= 1; i++) {
-      for (int j = -1; j <= 1; j++) {
-        pic.set(x + i, y + j, planetColor);
-      }
-    }
-  };
-
+                const Camera &camera, bool isPath, const Catalog *catalog,
+                int halfWidth) {
+  PROFILE_COUNTERS("drawBodies");
+
+  // reused between calls, drawing runs inside the integration loop
+  thread_local std::vector<Point> points;
+  thread_local std::vector<rgbColor> colors;
+  points.clear();
+  colors.clear();
+
+  // squares partly inside the window are kept for clipping
+  const int margin = isPath ? 0 : halfWidth;
+  Point p;
   for (auto &b : bodies) {
-    Coord pos = b.pos / M_PER_AU;
-    int x = scaleValue(pos.x, systemSize, center) + center;
-    int y = scaleValue(-pos.y, systemSize, center) + center;
-
-    // std::cout << x << std::endl;
-    // std::cout << y << std::endl;
+    if (!camera.project(b.pos, p, margin))
+      continue;
+    points.push_back(p);
+    if (!isPath)
+      colors.push_back(catalog ? catalog->colorOf(b.id) : rgbColor());
+  }
 
-    if (isPath) {
-      pic.set(x, y, cPath);
-    } else {
-      drawPlanet(b.name, x, y);
-    }
+  if (isPath) {
+    pic.plot(points, cPath);
+  } else {
+    pic.stamp(points, colors, halfWidth);
   }
 }
 
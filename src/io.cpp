@@ -1,15 +1,22 @@
+#include "../include/catalog.h"
 #include "../include/date.h"
+#include "../include/frame.h"
+#include "../include/io.h"
 #include "../include/json.h"
 #include "../include/keplerianApprox.h"
 #include "../include/planet.h"
 #include "../include/util.h"
 
+#include <algorithm>
+#include <cctype>
 #include <cmath>
 #include <fstream>
 #include <iomanip>
 #include <iostream>
 #include <sstream>
+#include <stdexcept>
 #include <string>
+#include <unordered_map>
 #include <vector>
 
 
@@ -29,83 +36,208 @@ std::string getString(const std::string &prompt) {
 }
 
 
-// requests date input from user and returns days since J200 epoch
-double getDate() {
+// parses a MM/DD/YYYY string, returns false if formatted incorrectly
+bool parseDate(const std::string &dateAsString, Date &date) {
+  int deliminatorCount = 0;
+  std::string numAsString = "0";
 
-  bool isFormatted = false;
-  Date date;
+  for (const char character : dateAsString) {
+    if (character == '/') {
+      deliminatorCount += 1;
 
-  do {
-    int deliminatorCount = 0;
-    std::string numAsString = "0";
-
-    const std::string dateAsString = getString("Enter a date (MM/DD/YYYY): ");
-
-    for (const char character : dateAsString) {
-      if (character == '/') {
-        deliminatorCount += 1;
-
-        if (deliminatorCount == 1) {
-          date.month = stoi(numAsString);
-          numAsString = "0";
-        } else if (deliminatorCount == 2) {
-          date.day = stoi(numAsString);
-          numAsString = "0";
-        }
-      } else {
-        numAsString += character;
+      if (deliminatorCount == 1) {
+        date.month = stoi(numAsString);
+        numAsString = "0";
+      } else if (deliminatorCount == 2) {
+        date.day = stoi(numAsString);
+        numAsString = "0";
       }
+    } else if (std::isdigit(static_cast<unsigned char>(character))) {
+      numAsString += character;
+    } else if (!std::isspace(static_cast<unsigned char>(character))) {
+      return false;
     }
+  }
 
-    date.year = stoi(numAsString);
+  date.year = stoi(numAsString);
 
-    if (deliminatorCount == 2 && date.month > 0 && date.month <= 12 &&
-        date.day > 0 && date.day <= 31) {
-      isFormatted = true;
-    } else {
-      std::cout << "Date formatted incorrectly, try again" << std::endl;
-    }
-  } while (!isFormatted);
+  return deliminatorCount == 2 && date.month > 0 && date.month <= 12 &&
+         date.day > 0 && date.day <= 31;
+}
+
+
+// requests date input from user and returns days since J200 epoch
+double getDate() {
+  Date date;
+
+  while (!parseDate(getString("Enter a date (MM/DD/YYYY): "), date)) {
+    std::cout << "Date formatted incorrectly, try again" << std::endl;
+  }
 
   return date.calcDaysSinceEpoch();
 }
 
 
-// displays formatted results
-void printResults(const std::vector<StateVector> &planets) {
-  const Coord earthPos = planets.at(2).pos;
-  const Coord sunPos = planets.at(planets.size() - 1).pos;
+// reads one MM/DD/YYYY date per line and returns days since J2000 epoch
+std::vector<double> readDates(const std::string &filename) {
+  std::ifstream fileStream(filename);
+  std::vector<double> dates;
+  std::string line;
+  int lineNumber = 0;
+
+  if (!fileStream)
+    throw std::runtime_error("Could not open " + filename + "\n");
+
+  while (std::getline(fileStream, line)) {
+    lineNumber++;
+
+    // skip blank lines and comments
+    const size_t start = line.find_first_not_of(" \t\r");
+    if (start == std::string::npos || line[start] == '#')
+      continue;
+
+    Date date;
+    if (!parseDate(line, date))
+      throw std::invalid_argument(filename + ":" + std::to_string(lineNumber) +
+                                  ": expected MM/DD/YYYY\n");
+
+    dates.push_back(date.calcDaysSinceEpoch());
+  }
+
+  return dates;
+}
+
 
-  for (StateVector p : planets) {
-    // if (p.name == "sun")
-    //   continue;
+// displays formatted results, distances from the central body and from Earth
+// when it is one of planets
+void printResults(const std::vector<StateVector> &planets) {
+  if (planets.empty())
+    return;
+
+  const Coord sunPos = planets[centralIndex(planets)].pos;
+  BodyId earthId;
+  const bool hasEarthId = findBodyId("earth", earthId);
+  const auto earth =
+      std::find_if(planets.begin(), planets.end(), [&](const StateVector &p) {
+        return hasEarthId && p.id == earthId;
+      });
+
+  for (const StateVector &p : planets) {
     std::cout << "----------------------------------\n";
     std::cout << std::fixed << std::setprecision(2);
-    std::cout << std::setw(27) << "Name: " << p.name << "\n";
+    std::cout << std::setw(27) << "Name: " << bodyName(p.id) << "\n";
     std::cout << std::setw(27) << "Distance from Sun [AU]: ";
     std::cout << sqrt(p.pos.magSquared(sunPos)) / M_PER_AU << std::endl;
-    std::cout << std::setw(27) << "Distance from Earth [AU]: ";
-    std::cout << sqrt(p.pos.magSquared(earthPos)) / M_PER_AU << std::endl;
+    if (earth != planets.end()) {
+      std::cout << std::setw(27) << "Distance from Earth [AU]: ";
+      std::cout << sqrt(p.pos.magSquared(earth->pos)) / M_PER_AU << std::endl;
+    }
     std::cout << std::setw(27) << "Vel [km/sec]: ";
-    std::cout << sqrt(p.vel.magSquared(Coord())) / M_PER_KM << std::endl;
+    std::cout << norm(p.vel) / M_PER_KM << std::endl;
+  }
+}
+
+
+// one row per body: julian day, name, position [m], velocity [m/s]
+void printCSV(const std::vector<Snapshot> &snapshots) {
+  std::cout << "jd,name,x,y,z,vx,vy,vz\n";
+  std::cout << std::scientific << std::setprecision(15);
+
+  for (const Snapshot &snapshot : snapshots) {
+    const double julianDay = snapshot.daysSinceEpoch + JD_EPOCH;
+    for (const StateVector &b : snapshot.bodies) {
+      std::cout << std::fixed << std::setprecision(5) << julianDay << ','
+                << bodyName(b.id) << ',' << std::scientific
+                << std::setprecision(15) << b.pos.x << ',' << b.pos.y << ','
+                << b.pos.z << ',' << b.vel.x << ',' << b.vel.y << ','
+                << b.vel.z << '\n';
+    }
+  }
+}
+
+
+// mirrors the layout of solutions.json, keyed by julian day
+void printJSON(const std::vector<Snapshot> &snapshots) {
+  auto printCoord = [](const Coord &c) {
+    std::cout << "{\"x\": " << c.x << ", \"y\": " << c.y
+              << ", \"z\": " << c.z << "}";
+  };
+
+  std::cout << "[\n" << std::scientific << std::setprecision(15);
+
+  for (size_t i = 0; i < snapshots.size(); i++) {
+    const Snapshot &snapshot = snapshots[i];
+    std::cout << "\t{\"JD" << std::fixed << std::setprecision(5)
+              << snapshot.daysSinceEpoch + JD_EPOCH << "\": [\n"
+              << std::scientific << std::setprecision(15);
+
+    for (size_t j = 0; j < snapshot.bodies.size(); j++) {
+      const StateVector &b = snapshot.bodies[j];
+      std::cout << "\t\t{\"name\": \"" << bodyName(b.id) << "\", \"pos\": ";
+      printCoord(b.pos);
+      std::cout << ", \"vel\": ";
+      printCoord(b.vel);
+      std::cout << ", \"mass\": " << b.mass << "}"
+                << (j + 1 < snapshot.bodies.size() ? "," : "") << '\n';
+    }
+
+    std::cout << "\t]}" << (i + 1 < snapshots.size() ? "," : "") << '\n';
   }
+
+  std::cout << "]\n";
 }
 
 
-// gets answers from solutions.json and display formatted comparison
+// displays every snapshot in the requested format
+void printSnapshots(const std::vector<Snapshot> &snapshots,
+                    const Format format) {
+  switch (format) {
+  case Format::CSV:
+    printCSV(snapshots);
+    break;
+  case Format::JSON:
+    printJSON(snapshots);
+    break;
+  case Format::Text:
+    for (const Snapshot &snapshot : snapshots) {
+      std::cout << "==================================\n";
+      std::cout << std::fixed << std::setprecision(1) << std::setw(27)
+                << "Julian Day: " << snapshot.daysSinceEpoch + JD_EPOCH
+                << '\n';
+      printResults(snapshot.bodies);
+    }
+    break;
+  }
+}
+
+
+// gets answers from solutions.json and display formatted comparison of every
+// body they cover, matched by name
 void printTest(const std::vector<StateVector> &bodies,
-               const double daysSinceEpoch) {
+               const double daysSinceEpoch, const std::string &solutionsFile) {
   std::vector<StateVector> solutionBodies;
-  populateSolutions(solutionBodies, daysSinceEpoch);
+  populateSolutions(solutionBodies, daysSinceEpoch, solutionsFile);
+
+  const std::unordered_map<BodyId, size_t> solutionIndices =
+      indexById(solutionBodies);
+
+  // solutions are heliocentric, the model's bodies need not be
+  std::vector<StateVector> heliocentric = bodies;
+  toFrame(heliocentric, Frame::Heliocentric);
 
   std::cout << "ERROR %\n\n";
-  StateVector sun = bodies.at(bodies.size() - 1);
-  for (size_t i = 0; i < bodies.size() - 1; i++) {
-    std::cout << std::setw(7) << "NAME: " << bodies[i].name << '\n';
-    double posObserved = bodies[i].pos.magSquared(sun.pos);
-    double posExpected = solutionBodies[i].pos.magSquared(sun.pos);
-    double velObserved = bodies[i].vel.magSquared(Coord());
-    double velExpected = solutionBodies[i].vel.magSquared(Coord());
+  const StateVector &sun = heliocentric.at(centralIndex(heliocentric));
+  for (const StateVector &body : heliocentric) {
+    const auto solution = solutionIndices.find(body.id);
+    if (solution == solutionIndices.end())
+      continue;
+    const StateVector &expected = solutionBodies[solution->second];
+
+    std::cout << std::setw(7) << "NAME: " << bodyName(body.id) << '\n';
+    double posObserved = body.pos.magSquared(sun.pos);
+    double posExpected = expected.pos.magSquared(sun.pos);
+    double velObserved = normSquared(body.vel);
+    double velExpected = normSquared(expected.vel);
 
     double posError =
         std::abs((posObserved - posExpected) / posExpected * 100.0);
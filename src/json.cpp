@@ -1,4 +1,6 @@
+#include "../include/catalog.h"
 #include "../include/planet.h"
+#include "../include/profile.h"
 #include "../include/util.h"
 
 #include <exception>
@@ -6,7 +8,9 @@
 #include <iomanip>
 #include <iostream>
 #include <sstream>
+#include <stdexcept>
 #include <string>
+#include <unordered_map>
 #include <vector>
 
 // returns value as string regardless of data type
@@ -28,13 +32,18 @@ std::string getValueFromJSONLine(const std::string &line) {
 
 // reads planets.json into a parallel vectors
 void populatePlanets(std::vector<OrbitalElements> &elements,
-                     std::vector<StateVector> &bodies) {
+                     std::vector<StateVector> &bodies,
+                     const std::string &filename, Catalog *catalog) {
+  PROFILE_SCOPE("populatePlanets");
   const std::string bodyStartKey = "\"name\": \"";
   std::fstream fileStream;
   std::string line;
   int numBodies = 0;
 
-  fileStream.open("planets.json");
+  fileStream.open(filename);
+
+  if (!fileStream)
+    throw std::runtime_error("Could not open " + filename + "\n");
 
   while (std::getline(fileStream, line)) {
     const size_t objectStart = line.find(bodyStartKey);
@@ -46,7 +55,7 @@ void populatePlanets(std::vector<OrbitalElements> &elements,
     OrbitalElements element;
     StateVector body;
 
-    body.name = getValueFromJSONLine(line);
+    body.id = internName(getValueFromJSONLine(line));
 
     std::getline(fileStream, line);
     element.semiMajorAxis = std::stod(getValueFromJSONLine(line)) * M_PER_AU;
@@ -72,6 +81,26 @@ void populatePlanets(std::vector<OrbitalElements> &elements,
     std::getline(fileStream, line);
     body.mass = std::stod(getValueFromJSONLine(line));
 
+    // optional properties, in any order, up to the end of the object
+    BodyInfo info;
+    bool hasColor = false;
+    while (std::getline(fileStream, line) &&
+           line.find('}') == std::string::npos) {
+      if (line.find("\"radius\"") != std::string::npos) {
+        body.radius = std::stod(getValueFromJSONLine(line)) * M_PER_KM;
+      } else if (line.find("\"class\"") != std::string::npos) {
+        info.type = parseBodyClass(getValueFromJSONLine(line));
+      } else if (line.find("\"color\"") != std::string::npos) {
+        info.color = parseColor(getValueFromJSONLine(line));
+        hasColor = true;
+      }
+    }
+    if (!hasColor)
+      info.color = defaultColor(info.type);
+    info.radius = body.radius;
+    if (catalog)
+      catalog->add(body.id, info);
+
     elements.emplace_back(element);
     bodies.emplace_back(body);
 
@@ -84,7 +113,9 @@ void populatePlanets(std::vector<OrbitalElements> &elements,
 
 
 void populateSolutions(std::vector<StateVector> &bodies,
-                       const double daysSinceEpoch) {
+                       const double daysSinceEpoch,
+                       const std::string &filename) {
+  PROFILE_SCOPE("populateSolutions");
 
   const double julianDay = daysSinceEpoch + 2451544.5;
   const bool isHalfDay = julianDay - static_cast<int>(julianDay) == 0.5;
@@ -99,7 +130,10 @@ void populateSolutions(std::vector<StateVector> &bodies,
   std::string line;
   int numBodies = 0;
 
-  fileStream.open("solutions.json");
+  fileStream.open(filename);
+
+  if (!fileStream)
+    throw std::runtime_error("Could not open " + filename + "\n");
 
   // get to correct data
   while (std::getline(fileStream, line)) {
@@ -108,7 +142,7 @@ void populateSolutions(std::vector<StateVector> &bodies,
       break;
   }
 
-  if (line.empty())
+  if (line.find(dataStartKey) == std::string::npos)
     throw std::domain_error("No test corresponding to input date found.\n");
 
   while (std::getline(fileStream, line) && line.find("]")) {
@@ -120,7 +154,7 @@ void populateSolutions(std::vector<StateVector> &bodies,
     // build element
     StateVector body;
 
-    body.name = getValueFromJSONLine(line);
+    body.id = internName(getValueFromJSONLine(line));
 
     std::getline(fileStream, line);
     std::getline(fileStream, line);
@@ -151,15 +185,21 @@ void populateSolutions(std::vector<StateVector> &bodies,
   bodies.resize(numBodies);
 }
 
-void populateStateVectors(std::vector<StateVector> &bodies) {
+void populateStateVectors(std::vector<StateVector> &bodies,
+                          const std::string &filename) {
+  PROFILE_SCOPE("populateStateVectors");
 
   const std::string dataStartKey = "JD2451544.5";
   const std::string bodyStartKey = "\"name\": \"";
+  const std::unordered_map<BodyId, size_t> indices = indexById(bodies);
+  std::vector<bool> isSet(bodies.size(), false);
   std::fstream fileStream;
   std::string line;
-  int bodiesIndex = 0;
 
-  fileStream.open("solutions.json");
+  fileStream.open(filename);
+
+  if (!fileStream)
+    throw std::runtime_error("Could not open " + filename + "\n");
 
   // get to correct data
   while (std::getline(fileStream, line)) {
@@ -168,7 +208,7 @@ void populateStateVectors(std::vector<StateVector> &bodies) {
       break;
   }
 
-  if (line.empty())
+  if (line.find(dataStartKey) == std::string::npos)
     throw std::domain_error("J2000 Epoch data not found.\n");
 
   while (std::getline(fileStream, line) &&
@@ -178,38 +218,43 @@ void populateStateVectors(std::vector<StateVector> &bodies) {
     if (objectStart == std::string::npos)
       continue;
 
-    bodies.at(bodiesIndex).name = getValueFromJSONLine(line);
+    BodyId id;
+    if (!findBodyId(getValueFromJSONLine(line), id))
+      continue;
+    const auto found = indices.find(id);
+    if (found == indices.end())
+      continue;
+
+    StateVector &body = bodies[found->second];
+    isSet[found->second] = true;
 
     std::getline(fileStream, line);
     std::getline(fileStream, line);
-    bodies.at(bodiesIndex).pos.x =
-        std::stod(getValueFromJSONLine(line)) * M_PER_KM;
+    body.pos.x = std::stod(getValueFromJSONLine(line)) * M_PER_KM;
     std::getline(fileStream, line);
-    bodies.at(bodiesIndex).pos.y =
-        std::stod(getValueFromJSONLine(line)) * M_PER_KM;
+    body.pos.y = std::stod(getValueFromJSONLine(line)) * M_PER_KM;
     std::getline(fileStream, line);
-    bodies.at(bodiesIndex).pos.z =
-        std::stod(getValueFromJSONLine(line)) * M_PER_KM;
+    body.pos.z = std::stod(getValueFromJSONLine(line)) * M_PER_KM;
 
     std::getline(fileStream, line);
     std::getline(fileStream, line);
     std::getline(fileStream, line);
-    bodies.at(bodiesIndex).vel.x =
-        std::stod(getValueFromJSONLine(line)) * M_PER_KM;
+    body.vel.x = std::stod(getValueFromJSONLine(line)) * M_PER_KM;
     std::getline(fileStream, line);
-    bodies.at(bodiesIndex).vel.y =
-        std::stod(getValueFromJSONLine(line)) * M_PER_KM;
+    body.vel.y = std::stod(getValueFromJSONLine(line)) * M_PER_KM;
     std::getline(fileStream, line);
-    bodies.at(bodiesIndex).vel.z =
-        std::stod(getValueFromJSONLine(line)) * M_PER_KM;
+    body.vel.z = std::stod(getValueFromJSONLine(line)) * M_PER_KM;
 
     std::getline(fileStream, line);
     std::getline(fileStream, line);
-    bodies.at(bodiesIndex).mass = std::stod(getValueFromJSONLine(line));
-
-    bodiesIndex++;
+    body.mass = std::stod(getValueFromJSONLine(line));
   }
 
-  if (bodiesIndex != 8)
-    throw std::range_error("Mismatch between json data and number of planets");
+  // the central body defines the origin and needs no state of its own
+  const size_t central = centralIndex(bodies);
+  for (size_t i = 0; i < bodies.size(); i++) {
+    if (!isSet[i] && i != central)
+      throw std::range_error("No J2000 state vector for " +
+                             bodyName(bodies[i].id));
+  }
 }
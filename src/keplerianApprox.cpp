@@ -2,8 +2,11 @@
 #include "../include/io.h"
 #include "../include/planet.h"
 #include "../include/util.h"
+#include "../include/vec.h"
 
+#include <algorithm>
 #include <cmath>
+#include <thread>
 #include <vector>
 
 
@@ -79,13 +82,14 @@ void calcStateVectors(const OrbitalElements &element, StateVector &body,
   // The radius vector (r)
   const double r = sqrt(xv * xv + yv * yv);
 
-  // vector components used for both position and velocity
-  const double xh = cos(o) * cos(v + p - o) - sin(o) * sin(v + p - o) * cos(i);
-  const double yh = sin(o) * cos(v + p - o) + cos(o) * sin(v + p - o) * cos(i);
-  const double zh = sin(v + p - o) * sin(i);
+  // Direction of the body, used for both position and velocity. The orbital
+  // plane is turned up by the inclination about the ascending node, then the
+  // node about the ecliptic pole
+  const Mat3d orientation = Mat3d::rotationZ(o) * Mat3d::rotationX(i);
+  const Vec3d h = orientation * Vec3d{cos(v + p - o), sin(v + p - o), 0.0};
 
   // Heliocentric position in 3D space
-  body.pos = {r * xh, r * yh, r * zh};
+  body.pos = toCoord(h * r);
 
   // Standard gravitational parameter (mu)
   const double mu = G * (M_SUN + body.mass);
@@ -95,7 +99,7 @@ void calcStateVectors(const OrbitalElements &element, StateVector &body,
 
   // Heliocentric orbital velocity vector in 3D space, assuming the satellite's
   // motion is counterclockwise
-  body.vel = {orbitalSpeed * -yh, orbitalSpeed * xh, orbitalSpeed * zh};
+  body.vel = toCoord(Vec3d{-h[1], h[0], h[2]} * orbitalSpeed);
 }
 
 // One-body approximation
@@ -103,9 +107,43 @@ void keplerianApprox(const std::vector<OrbitalElements> &elements,
                      std::vector<StateVector> &bodies,
                      const double daysSinceEpoch) {
 
-  for (size_t i = 0; i < bodies.size(); i++) {
-    if (bodies.at(i).name == "sun")
-      continue;
-    calcStateVectors(elements.at(i), bodies.at(i), daysSinceEpoch);
+  // bodies past the last elements, the Sun, stay where they are
+  const size_t count = std::min(elements.size(), bodies.size());
+  for (size_t i = 0; i < count; i++) {
+    calcStateVectors(elements[i], bodies[i], daysSinceEpoch);
   }
 };
+
+
+// One-body approximation at every snapshot's epoch, split across threads
+void keplerianApprox(const std::vector<OrbitalElements> &elements,
+                     const std::vector<StateVector> &bodies,
+                     std::vector<Snapshot> &snapshots, unsigned threadCount,
+                     const SnapshotObserver &snapshotObserver) {
+
+  threadCount = std::max(1u, std::min<unsigned>(threadCount, snapshots.size()));
+  const size_t chunkSize = (snapshots.size() + threadCount - 1) / threadCount;
+
+  auto worker = [&](size_t begin, size_t end) {
+    for (size_t i = begin; i < end; i++) {
+      snapshots[i].bodies = bodies;
+      keplerianApprox(elements, snapshots[i].bodies,
+                      snapshots[i].daysSinceEpoch);
+      if (snapshotObserver)
+        snapshotObserver(i, snapshots[i]);
+    }
+  };
+
+  std::vector<std::thread> workers;
+  for (size_t begin = chunkSize; begin < snapshots.size(); begin += chunkSize) {
+    workers.emplace_back(worker, begin,
+                         std::min(begin + chunkSize, snapshots.size()));
+  }
+
+  // the calling thread takes the first chunk
+  worker(0, std::min(chunkSize, snapshots.size()));
+
+  for (std::thread &t : workers) {
+    t.join();
+  }
+}
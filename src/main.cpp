@@ -1,5 +1,16 @@
+#include <exception>
+#include <iostream>
+#include <memory>
 #include <vector>
 
+#include "../include/animation.h"
+#include "../include/camera.h"
+#include "../include/catalog.h"
+#include "../include/cli.h"
+#include "../include/density.h"
+#include "../include/diagnostics.h"
+#include "../include/ephemeris.h"
+#include "../include/frame.h"
 #include "../include/helpers.h"
 #include "../include/io.h"
 #include "../include/json.h"
@@ -7,29 +18,212 @@
 #include "../include/nBodyApprox.h"
 #include "../include/picture.h"
 #include "../include/planet.h"
+#include "../include/profile.h"
+#include "../include/server.h"
+#include "../include/threadPool.h"
+#include "../include/tiles.h"
+#include "../include/trails.h"
 #include "../include/util.h"
 
 
-int main() {
+// computes, prints and draws every requested snapshot
+int run(const Options &options) {
   // Initialize system
   std::vector<OrbitalElements> elements;
   std::vector<StateVector> bodies;
-  populatePlanets(elements, bodies);
-  static StateVector sun = {"sun", Coord(), Coord(), M_SUN};
-  bodies.emplace_back(sun);
+  Catalog catalog;
+  populatePlanets(elements, bodies, options.planetsFile, &catalog);
+  addSun(bodies, &catalog);
 
   // Initialize picture
   const rgbColor cBackground = {13, 5, 41};
-  const size_t picSize = 2000;
+  const int picSize = options.pictureSize;
   const size_t systemSize = approxSystemSize(elements);
-  Picture pic(picSize, picSize, cBackground);
+  const int supersample = options.supersample;
+  const int canvasSize = picSize * supersample;
+  const Camera camera(canvasSize, systemSize, options.view);
 
-  const double daysSinceEpoch = getDate();
-  // keplerianApprox(elements, bodies, daysSinceEpoch);
-  nBodyApprox(bodies, daysSinceEpoch, pic, systemSize);
+  // tiled pictures are only held a band at a time, while saving
+  const bool isTiled = options.render && options.tileRows > 0;
+  Picture pic;
+  if (options.render && !isTiled) {
+    pic = Picture(canvasSize, canvasSize, cBackground);
 
-  // printTest(bodies, daysSinceEpoch);
-  printResults(bodies);
-  drawBodies(bodies, pic, systemSize, false);
-  pic.save("result.png");
+    // bodies beyond the system size are clipped rather than growing the image
+    pic.setFixed(true);
+    pic.setIndexed(options.isIndexed);
+  }
+
+  // every step's bodies are drawn as paths, or counted into a density map
+  const rgbColor cDensity = {255, 225, 180};
+  DensityMap density(camera);
+  std::unique_ptr<PathMask> paths;
+  std::unique_ptr<TrailRenderer> trails;
+  StepObserver pathObserver = nullptr;
+  if (isTiled) {
+    paths = std::make_unique<PathMask>(camera);
+    pathObserver = [&paths](const std::vector<StateVector> &b) {
+      paths->mark(b);
+    };
+  } else if (options.render && options.isDensity) {
+    pathObserver = [&density](const std::vector<StateVector> &b) {
+      density.accumulate(b);
+    };
+  } else if (options.render && options.trailSpacing > 0) {
+    trails = std::make_unique<TrailRenderer>(
+        pic, camera, cPath, options.trailSpacing * supersample);
+    pathObserver = trails->observer();
+  } else if (options.render) {
+    pathObserver = pathDrawer(pic, camera);
+  }
+
+  std::vector<double> dates = options.dates;
+  if (dates.empty())
+    dates.push_back(getDate());
+
+  std::vector<Snapshot> snapshots(dates.size());
+  for (size_t i = 0; i < snapshots.size(); i++) {
+    snapshots[i].daysSinceEpoch = dates[i];
+  }
+
+  // frames are rendered and encoded as snapshots arrive, not after the run
+  std::unique_ptr<FramePipeline> frames;
+  SnapshotObserver snapshotObserver = nullptr;
+  const AnimationOptions &animation = options.animation;
+  if (!animation.prefix.empty() || !animation.rawFile.empty()) {
+    AnimationOptions frameOptions = animation;
+    frameOptions.encoderThreads = options.threads;
+    frameOptions.isIndexed = options.isIndexed;
+    frameOptions.isFastPng = options.isFastPng;
+    frameOptions.png = options.png;
+    frames = std::make_unique<FramePipeline>(
+        frameOptions, Camera(picSize, systemSize, options.view), cBackground,
+        &catalog);
+    snapshotObserver = [&frames](size_t i, const Snapshot &snapshot) {
+      frames->submit(i, snapshot.bodies);
+    };
+  }
+
+  if (options.mode == Mode::Keplerian) {
+    keplerianApprox(elements, bodies, snapshots, options.threads,
+                    snapshotObserver);
+  } else {
+    const bool hasDiagnostics = !options.diagnosticsFile.empty();
+    std::vector<Invariants> invariants;
+    nBodyApprox(bodies, snapshots, pathObserver, options.solutionsFile,
+                hasDiagnostics ? &invariants : nullptr,
+                options.diagnosticsInterval, options.integrator,
+                snapshotObserver);
+
+    if (hasDiagnostics) {
+      const double maxDrift =
+          writeInvariants(options.diagnosticsFile, invariants);
+      std::cerr << "Largest relative energy drift: " << maxDrift << '\n';
+    }
+  }
+
+  if (frames) {
+    frames->finish();
+    std::cerr << "Wrote " << frames->written() << " frames";
+    if (frames->dropped() > 0)
+      std::cerr << ", dropped " << frames->dropped();
+    std::cerr << '\n';
+  }
+
+  // integration stays in its own frame, only the printed vectors convert
+  std::vector<Snapshot> output = snapshots;
+  for (Snapshot &snapshot : output) {
+    toFrame(snapshot.bodies, options.frame);
+  }
+  printSnapshots(output, options.format);
+
+  if (options.test) {
+    for (const Snapshot &snapshot : snapshots) {
+      printTest(snapshot.bodies, snapshot.daysSinceEpoch,
+                options.solutionsFile);
+    }
+  }
+
+  if (isTiled) {
+    PngOptions png = options.png;
+    png.threads = options.threads;
+    renderTiles(
+        options.outputFile, camera, options.tileRows, cBackground,
+        [&](Picture &tile, const Camera &window) {
+          paths->draw(tile, window, cPath);
+          for (const Snapshot &snapshot : snapshots) {
+            drawBodies(snapshot.bodies, tile, window, false, &catalog);
+          }
+        },
+        png);
+  } else if (options.render) {
+    if (options.isDensity) {
+      for (const Snapshot &snapshot : snapshots) {
+        density.accumulate(snapshot.bodies, options.threads);
+      }
+      density.render(pic, cDensity, options.toneMap, options.gamma);
+    }
+    // bodies keep their 3 pixel size after averaging down
+    for (const Snapshot &snapshot : snapshots) {
+      drawBodies(snapshot.bodies, pic, camera, false, &catalog,
+                 3 * supersample / 2);
+    }
+    if (supersample > 1) {
+      pic.downsample(supersample, options.threads);
+      pic.setIndexed(options.isIndexed);
+    }
+    if (options.isFastPng) {
+      PngOptions png = options.png;
+      png.threads = options.threads;
+      pic.save(options.outputFile, png);
+    } else {
+      pic.save(options.outputFile);
+    }
+  }
+
+  return 0;
+}
+
+
+int main(int argc, char *argv[]) {
+  Options options;
+  try {
+    options = parseArgs(argc, argv);
+  } catch (const std::exception &e) {
+    std::cerr << e.what() << "\n\n";
+    printUsage(argv[0]);
+    return 1;
+  }
+
+  if (options.help) {
+    printUsage(argv[0]);
+    return 0;
+  }
+
+  setProfileCounting(options.isCounting);
+
+  try {
+    int status = 0;
+    if (options.serve) {
+      // parsed data and integrated checkpoints stay warm between queries
+      Ephemeris ephemeris(options.planetsFile, options.solutionsFile,
+                          options.checkpointDays);
+      ThreadPool pool(options.threads);
+
+      if (options.socketPath.empty()) {
+        serveStream(ephemeris, pool);
+      } else {
+        serveSocket(ephemeris, pool, options.socketPath);
+      }
+    } else {
+      status = run(options);
+    }
+
+    if (!options.traceFile.empty())
+      writeTrace(options.traceFile);
+    return status;
+  } catch (const std::exception &e) {
+    std::cerr << e.what() << '\n';
+    return 1;
+  }
 }
@@ -1,93 +1,484 @@
 #include <algorithm>
 #include <cmath>
+#include <memory>
+#include <mutex>
 #include <numeric>
+#include <thread>
+#include <utility>
 #include <vector>
 
+#include "../include/collision.h"
 #include "../include/coord.h"
+#include "../include/diagnostics.h"
+#include "../include/encounter.h"
+#include "../include/frame.h"
 #include "../include/helpers.h"
 #include "../include/json.h"
+#include "../include/nBodyApprox.h"
 #include "../include/picture.h"
 #include "../include/planet.h"
+#include "../include/profile.h"
 #include "../include/util.h"
 
 
-// Updates heliocentric acceleration vectors for both bodies involved [m/s/s]
-void calcAcc(const StateVector &p1, const StateVector &p2, Coord &acc1,
-             Coord &acc2) {
+// Updates acceleration vectors for both bodies involved [m/s/s], and the
+// potential energy of the pair when it is not null [J]. Returns the squared
+// distance between the bodies [m^2]
+double calcAcc(const StateVector &p1, const StateVector &p2, Coord &acc1,
+               Coord &acc2, double *potentialEnergy) {
   const Coord r = p2.pos - p1.pos;
-  const double distanceSquared = r.x * r.x + r.y * r.y + r.z * r.z;
+  const double distanceSquared = normSquared(r);
   const double invDistanceCubed =
       G / (distanceSquared * std::sqrt(distanceSquared));
 
-  acc1 += r * (invDistanceCubed * p2.mass);
-  acc2 -= r * (invDistanceCubed * p1.mass);
+  acc1.addScaled(r, invDistanceCubed * p2.mass);
+  acc2.subScaled(r, invDistanceCubed * p1.mass);
+
+  // G * m1 * m2 / r, from the terms already computed
+  if (potentialEnergy)
+    *potentialEnergy -= invDistanceCubed * distanceSquared * p1.mass * p2.mass;
+
+  return distanceSquared;
 }
 
 
 // Adds together acceleration vectors produced by the gravitational force of
-// the sun, and for every planet except itself
+// every other body
 Coord sumAcc(const StateVector &p, size_t pIndex,
              const std::vector<StateVector> &planets) {
-
-  static std::vector<Coord> accumulatedAcc(planets.size(), Coord());
   Coord netAcc = Coord();
-
-  for (size_t i = pIndex + 1; i < planets.size(); i++) {
-    calcAcc(p, planets[i], netAcc, accumulatedAcc[i]);
+  Coord ignored = Coord();
+  for (size_t i = 0; i < planets.size(); i++) {
+    if (i != pIndex)
+      calcAcc(p, planets[i], netAcc, ignored);
   }
 
   return netAcc;
 }
 
 
-// Approximate new position and velocity vectors for a given interval using
-// 4th-Order Runge-Kutta. Returns updated body
-StateVector rungeKuttaStep(size_t pIndex,
-                           const std::vector<StateVector> &planets, int dt) {
+// Pair loop of accelerations, compiled apart when watching for encounters so
+// the plain loop carries no check
+template <bool isWatching>
+void pairForces(const std::vector<StateVector> &bodies,
+                std::vector<Coord> &acc, double *potentialEnergy,
+                const std::vector<double> *encounterRadii,
+                std::vector<std::pair<size_t, size_t>> *encounters) {
+  for (size_t i = 0; i < bodies.size(); i++) {
+    for (size_t j = i + 1; j < bodies.size(); j++) {
+      const double distanceSquared =
+          calcAcc(bodies[i], bodies[j], acc[i], acc[j], potentialEnergy);
 
-  const static double sixth = 1 / 6.0;
-  StateVector p = planets[pIndex];
+      if (isWatching) {
+        const double ri = (*encounterRadii)[i];
+        const double rj = (*encounterRadii)[j];
+        if (std::min(ri, rj) >= 0.0 && distanceSquared < std::max(ri, rj))
+          encounters->emplace_back(i, j);
+      }
+    }
+  }
+}
 
-  const Coord k1v = sumAcc(p, pIndex, planets) * dt;
-  const Coord k1r = p.vel * dt;
-  const StateVector k1Body{"", p.pos + k1r * 0.5, p.vel + k1v * 0.5, p.mass};
 
-  const Coord k2v = sumAcc(k1Body, pIndex, planets) * dt;
-  const Coord k2r = (p.vel + k1v * 0.5) * dt;
-  const StateVector K2Body{"", p.pos + k2r * 0.5, p.vel + k2v * 0.5, p.mass};
+// Acceleration of every body at its current position [m/s/s]. Every pair is
+// visited once and its force applied to both bodies, so the forces are equal
+// and opposite. Adds the potential energy of every pair when potentialEnergy
+// is not null. When encounterRadii, squared, is not null, every pair closer
+// than the larger of its two radii, neither negative, is appended to
+// encounters
+void accelerations(const std::vector<StateVector> &bodies,
+                   std::vector<Coord> &acc, double *potentialEnergy,
+                   const std::vector<double> *encounterRadii,
+                   std::vector<std::pair<size_t, size_t>> *encounters) {
+  PROFILE_SCOPE("accelerations");
+  acc.assign(bodies.size(), Coord());
+  if (encounterRadii) {
+    encounters->clear();
+    pairForces<true>(bodies, acc, potentialEnergy, encounterRadii, encounters);
+  } else {
+    pairForces<false>(bodies, acc, potentialEnergy, nullptr, nullptr);
+  }
+}
 
-  const Coord k3v = sumAcc(K2Body, pIndex, planets) * dt;
-  const Coord k3r = (p.vel + k2v * 0.5) * dt;
-  const StateVector K3Body{"", p.pos + k3r, p.vel + k3v, p.mass};
 
-  const Coord k4v = sumAcc(K3Body, pIndex, planets) * dt;
-  const Coord k4r = (p.vel + k3v) * dt;
+std::vector<Coord> accelerations(const std::vector<StateVector> &bodies) {
+  std::vector<Coord> acc;
+  accelerations(bodies, acc);
+  return acc;
+}
 
-  p.vel += (k1v + k2v * 2.0 + k3v * 2.0 + k4v) * sixth;
-  p.pos += (k1r + k2r * 2.0 + k3r * 2.0 + k4r) * sixth;
 
+// Kahan summation: adds value to sum, carrying the low-order bits lost to
+// round-off in error so they are added back on the next call
+void compensatedAdd(Coord &sum, Coord &error, const Coord &value) {
+  const Coord y = value - error;
+  const Coord t = sum + y;
+  error = (t - sum) - y;
+  sum = t;
+}
+
+
+// (a + 2b + 2c + d) / 6, the weighting of the four Runge-Kutta stages, summed
+// in that order without forming the doubled stages
+Coord rungeKuttaSum(const Coord &a, const Coord &b, const Coord &c,
+                    const Coord &d) {
+  const static double sixth = 1 / 6.0;
+  Coord sum = scaleAdd(b, 2.0, a);
+  sum.addScaled(c, 2.0);
+  sum += d;
+  return sum * sixth;
+}
+
+
+// Evaluates the continuous extension of a Runge-Kutta step a fraction theta
+// of the way through it. Third order accurate, and needs no extra force
+// evaluations since it only reweights the stages of the step
+StateVector denseOutput(const StateVector &start,
+                        const RungeKuttaStages &stages, double theta) {
+  const double theta2 = theta * theta;
+  const double theta3 = theta2 * theta;
+
+  const double b1 = theta - 1.5 * theta2 + 2.0 / 3.0 * theta3;
+  const double b23 = theta2 - 2.0 / 3.0 * theta3;
+  const double b4 = -0.5 * theta2 + 2.0 / 3.0 * theta3;
+
+  auto weighted = [&](const Coord (&k)[4]) {
+    Coord sum = scaleAdd(k[1] + k[2], b23, k[0] * b1);
+    sum.addScaled(k[3], b4);
+    return sum;
+  };
+
+  StateVector p = start;
+  p.vel += weighted(stages.kv);
+  p.pos += weighted(stages.kr);
   return p;
 }
 
 
+// Advances every body by one step of dt seconds into updatedBodies, keeping
+// each body's stage increments when stages is not null and reusing initialAcc
+// as the first stage when it is not null. Every stage moves all bodies
+// together, so each force evaluation sees one consistent configuration. The
+// first stage visits every pair, so it also sums the potential energy when
+// potentialEnergy is not null and finds the pairs in a close encounter when
+// encounters is not null. Those bodies are then re-integrated by encounters.
+// Updates are compensated when compensation is not null
+void step(const std::vector<StateVector> &bodies,
+          std::vector<StateVector> &updatedBodies, int dt,
+          std::vector<RungeKuttaStages> *stages,
+          const std::vector<Coord> *initialAcc, double *potentialEnergy,
+          std::vector<Compensation> *compensation,
+          EncounterSolver *encounters) {
+  PROFILE_SCOPE("step");
+  const size_t n = bodies.size();
+  updatedBodies.resize(n);
+  if (compensation)
+    compensation->resize(n);
+
+  // per thread so concurrent integrations do not share them
+  thread_local std::vector<RungeKuttaStages> localStages;
+  thread_local std::vector<StateVector> stageBodies;
+  thread_local std::vector<Coord> acc;
+  std::vector<RungeKuttaStages> &k = stages ? *stages : localStages;
+  k.resize(n);
+  stageBodies = bodies;
+
+  {
+    PROFILE_COUNTERS("step.stages");
+    if (initialAcc && !potentialEnergy && !encounters) {
+      acc = *initialAcc;
+    } else {
+      accelerations(bodies, acc, potentialEnergy,
+                    encounters ? &encounters->updateRadii(bodies) : nullptr,
+                    encounters ? &encounters->pairs() : nullptr);
+    }
+
+    // stage s is evaluated at the start offset by weight times stage s - 1
+    const double weights[3] = {0.5, 0.5, 1.0};
+    for (int s = 0; s < 4; s++) {
+      for (size_t j = 0; j < n; j++) {
+        const StateVector &p = bodies[j];
+        const Coord vel = s == 0 ? p.vel
+                                 : scaleAdd(k[j].kv[s - 1], weights[s - 1],
+                                            p.vel);
+        k[j].kv[s] = acc[j] * dt;
+        k[j].kr[s] = vel * dt;
+        if (s < 3) {
+          stageBodies[j].pos = scaleAdd(k[j].kr[s], weights[s], p.pos);
+          stageBodies[j].vel = scaleAdd(k[j].kv[s], weights[s], p.vel);
+        }
+      }
+      if (s < 3)
+        accelerations(stageBodies, acc);
+    }
+
+    for (size_t j = 0; j < n; j++) {
+      const RungeKuttaStages &kj = k[j];
+      const Coord dv = rungeKuttaSum(kj.kv[0], kj.kv[1], kj.kv[2], kj.kv[3]);
+      const Coord dr = rungeKuttaSum(kj.kr[0], kj.kr[1], kj.kr[2], kj.kr[3]);
+
+      StateVector &p = updatedBodies[j];
+      p = bodies[j];
+      if (compensation) {
+        compensatedAdd(p.vel, (*compensation)[j].vel, dv);
+        compensatedAdd(p.pos, (*compensation)[j].pos, dr);
+      } else {
+        p.vel += dv;
+        p.pos += dr;
+      }
+    }
+  }
+
+  if (encounters) {
+    PROFILE_SCOPE("step.encounters");
+    const std::vector<size_t> &resolved =
+        encounters->resolve(bodies, updatedBodies, dt);
+
+    // round-off of the replaced regular updates no longer applies
+    if (compensation) {
+      for (const size_t j : resolved) {
+        (*compensation)[j] = Compensation();
+      }
+    }
+  }
+}
+
+
+// Advances every body by the given number of steps of dt seconds, showing the
+// bodies to observer before each step and sampling them into diagnostics.
+// Updates are compensated when compensation is not null, and bodies in a close
+// encounter are re-integrated by encounters when it is not null. Bodies are
+// merged and ejected by collisions after every step when it is not null
+void integrate(std::vector<StateVector> &bodies, int steps, int dt,
+               const StepObserver &observer, Diagnostics *diagnostics,
+               std::vector<Compensation> *compensation,
+               EncounterSolver *encounters, CollisionSolver *collisions) {
+  std::vector<StateVector> updatedBodies(bodies.size());
+
+  for (int i = 0; i < steps; i++) {
+    const bool isSampled = diagnostics && diagnostics->isDue();
+    double potentialEnergy = 0.0;
+    step(bodies, updatedBodies, dt, nullptr, nullptr,
+         isSampled ? &potentialEnergy : nullptr, compensation, encounters);
+
+    if (observer) {
+      PROFILE_SCOPE("observer");
+      observer(bodies);
+    }
+    if (diagnostics)
+      diagnostics->onStep(bodies, potentialEnergy);
+
+    bodies.swap(updatedBodies);
+    if (collisions) {
+      PROFILE_SCOPE("collisions");
+      collisions->apply(bodies, compensation);
+    }
+  }
+}
+
+
+DenseIntegrator::DenseIntegrator(const std::vector<StateVector> &bodies,
+                                 int dt, StepObserver observer,
+                                 std::vector<Coord> initialAcc,
+                                 Diagnostics *diagnostics,
+                                 const IntegratorOptions &options)
+    : _bodies(bodies), _initialAcc(std::move(initialAcc)), _dt(dt),
+      _observer(std::move(observer)), _diagnostics(diagnostics) {
+  if (options.isCompensated)
+    _compensation.resize(bodies.size());
+  if (options.encounterHillRadii > 0.0)
+    _encounters = std::make_unique<EncounterSolver>(options.encounterHillRadii);
+  if (options.collisionRadiusScale > 0.0 || options.ejectionDistance > 0.0) {
+    _collisions = std::make_unique<CollisionSolver>(
+        options.collisionRadiusScale, options.ejectionDistance);
+
+    // the given accelerations are for bodies that no longer all exist
+    if (_collisions->apply(_bodies, _compensation.empty() ? nullptr
+                                                          : &_compensation))
+      _initialAcc.clear();
+  }
+}
+
+
+DenseIntegrator::~DenseIntegrator() = default;
+
+
+std::vector<StateVector> DenseIntegrator::at(double steps) {
+  int whole = std::floor(steps);
+  double theta = steps - whole;
+
+  // results within round-off of a grid point are taken from the grid
+  if (theta > 1.0 - 1e-9) {
+    whole++;
+    theta = 0.0;
+  } else if (theta < 1e-9) {
+    theta = 0.0;
+  }
+
+  advance(whole);
+  if (theta == 0.0)
+    return _bodies;
+
+  if (!_hasNext)
+    computeNext();
+
+  std::vector<StateVector> result(_bodies.size());
+  for (size_t j = 0; j < _bodies.size(); j++) {
+    result[j] = denseOutput(_bodies[j], _stages[j], theta);
+  }
+  return result;
+}
+
+
+// computes and keeps the step following the current one
+void DenseIntegrator::computeNext() {
+  const bool isFirst = _stepsTaken == 0 && !_initialAcc.empty();
+  const bool isSampled = _diagnostics && _diagnostics->isDue();
+  _potentialEnergy = 0.0;
+
+  // the kept step must not touch the error terms until it is taken
+  _nextCompensation = _compensation;
+  step(_bodies, _next, _dt, &_stages, isFirst ? &_initialAcc : nullptr,
+       isSampled ? &_potentialEnergy : nullptr,
+       _compensation.empty() ? nullptr : &_nextCompensation,
+       _encounters.get());
+  _hasNext = true;
+}
+
+
+// integrates forward to the given whole step, reusing the kept step
+void DenseIntegrator::advance(int whole) {
+  if (whole > _stepsTaken && !_hasNext && !_initialAcc.empty() &&
+      _stepsTaken == 0)
+    computeNext();
+
+  if (whole > _stepsTaken && _hasNext) {
+    if (_observer) {
+      PROFILE_SCOPE("observer");
+      _observer(_bodies);
+    }
+    if (_diagnostics)
+      _diagnostics->onStep(_bodies, _potentialEnergy);
+    _bodies.swap(_next);
+    _compensation.swap(_nextCompensation);
+    _stepsTaken++;
+    _hasNext = false;
+    if (_collisions) {
+      PROFILE_SCOPE("collisions");
+      _collisions->apply(_bodies,
+                         _compensation.empty() ? nullptr : &_compensation);
+    }
+  }
+
+  if (whole > _stepsTaken) {
+    integrate(_bodies, whole - _stepsTaken, _dt, _observer, _diagnostics,
+              _compensation.empty() ? nullptr : &_compensation,
+              _encounters.get(), _collisions.get());
+    _stepsTaken = whole;
+  }
+}
+
+
+// observer drawing the bodies of every step onto pic as paths, safe to share
+// between threads
+StepObserver pathDrawer(Picture &pic, const Camera &camera) {
+  auto mutex = std::make_shared<std::mutex>();
+  return [&pic, camera, mutex](const std::vector<StateVector> &b) {
+    std::lock_guard<std::mutex> lock(*mutex);
+    drawBodies(b, pic, camera);
+  };
+}
+
+
 // N-body model
 void nBodyApprox(std::vector<StateVector> &bodies, double daysSinceEpoch,
                  Picture &pic, size_t systemSize) {
+  std::vector<Snapshot> snapshots = {{daysSinceEpoch, {}}};
+  nBodyApprox(bodies, snapshots,
+              pathDrawer(pic, Camera(pic.width(), systemSize)));
+  bodies = snapshots[0].bodies;
+};
 
-  // Data from J2000 epoch
-  populateStateVectors(bodies);
 
-  // Numerically integrate, using each step to update planet
-  const int dt = (daysSinceEpoch < 0 ? -1 : 1) * SEC_PER_DAY / 4; // 6-hours
-  const int steps = round(SEC_PER_DAY * abs(daysSinceEpoch) / double(abs(dt)));
-  for (int i = 0; i < steps; i++) {
-    std::vector<StateVector> updatedBodies(bodies.size());
+// N-body model over many epochs. Integrates once in each direction from J2000,
+// filling in every snapshot as its epoch is passed. Both directions start from
+// the same force evaluation and run concurrently when both are needed
+void nBodyApprox(const std::vector<StateVector> &bodies,
+                 std::vector<Snapshot> &snapshots,
+                 const StepObserver &pathObserver,
+                 const std::string &solutionsFile,
+                 std::vector<Invariants> *invariants, int diagnosticsInterval,
+                 const IntegratorOptions &integratorOptions,
+                 const SnapshotObserver &snapshotObserver) {
 
-    for (size_t j = 0; j < bodies.size(); j++) {
-      updatedBodies[j] = rungeKuttaStep(j, bodies, dt);
-      drawBodies(bodies, pic, systemSize);
+  // Data from J2000 epoch, integrated about the center of mass so the
+  // central body is free to move without the whole system drifting
+  std::vector<StateVector> initialBodies = bodies;
+  populateStateVectors(initialBodies, solutionsFile);
+  toFrame(initialBodies, Frame::Barycentric);
+  const std::vector<Coord> initialAcc = accelerations(initialBodies);
+
+  std::vector<size_t> order(snapshots.size());
+  std::iota(order.begin(), order.end(), 0);
+  std::sort(order.begin(), order.end(), [&snapshots](size_t a, size_t b) {
+    return std::abs(snapshots[a].daysSinceEpoch) <
+           std::abs(snapshots[b].daysSinceEpoch);
+  });
+
+  // Each direction writes only the snapshots on its side of J2000, so the
+  // results merge back into request order without further synchronization
+  Diagnostics backwardDiagnostics(-SEC_PER_DAY / 4, diagnosticsInterval);
+  Diagnostics forwardDiagnostics(SEC_PER_DAY / 4, diagnosticsInterval);
+
+  auto sweep = [&](const int direction) {
+    const int dt = direction * SEC_PER_DAY / 4; // 6-hours
+    Diagnostics *diagnostics = nullptr;
+    if (invariants)
+      diagnostics = direction < 0 ? &backwardDiagnostics : &forwardDiagnostics;
+
+    DenseIntegrator integrator(initialBodies, dt, pathObserver, initialAcc,
+                               diagnostics, integratorOptions);
+
+    for (const size_t i : order) {
+      const double daysSinceEpoch = snapshots[i].daysSinceEpoch;
+      if ((daysSinceEpoch < 0 ? -1 : 1) != direction)
+        continue;
+
+      snapshots[i].bodies =
+          integrator.at(SEC_PER_DAY * std::abs(daysSinceEpoch) / abs(dt));
+      if (snapshotObserver)
+        snapshotObserver(i, snapshots[i]);
     }
+  };
 
-    bodies = updatedBodies;
+  const bool hasPast = std::any_of(
+      snapshots.begin(), snapshots.end(),
+      [](const Snapshot &snapshot) { return snapshot.daysSinceEpoch < 0; });
+
+  if (hasPast) {
+    std::thread backward(sweep, -1);
+    sweep(1);
+    backward.join();
+  } else {
+    sweep(1);
+  }
+
+  // one time series, oldest first, with the shared initial state once
+  if (invariants) {
+    const std::vector<Invariants> &past = backwardDiagnostics.samples();
+    const std::vector<Invariants> &future = forwardDiagnostics.samples();
+    invariants->assign(past.rbegin(), past.rend());
+    if (!invariants->empty() && !future.empty())
+      invariants->pop_back();
+    invariants->insert(invariants->end(), future.begin(), future.end());
+
+    // no step was taken when every query is at J2000, only the initial state
+    if (invariants->empty()) {
+      double potentialEnergy = 0.0;
+      std::vector<Coord> acc;
+      accelerations(initialBodies, acc, &potentialEnergy);
+      invariants->push_back(
+          calcInvariants(initialBodies, potentialEnergy, 0.0));
+    }
   }
 };
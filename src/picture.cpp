@@ -1,9 +1,11 @@
-
 #include "../include/picture.h"
+#include "../include/profile.h"
 
 #include <algorithm>
+#include <cstdint>
 #include <cstring>
 #include <stdexcept>
+#include <thread>
 #include <vector>
 
 Picture::Picture() {
@@ -12,19 +14,9 @@ Picture::Picture() {
 }
 
 Picture::Picture(int width, int height, rgbColor color)
-    : _values(width * height * 4) {
+    : _pixels(size_t(width) * height, pack(color)) {
   _width = width;
   _height = height;
-  const int red = color.r;
-  const int green = color.g;
-  const int blue = color.b;
-
-  for (size_t k = 0; k < _values.size(); k += 4) {
-    _values[k] = red;
-    _values[k + 1] = green;
-    _values[k + 2] = blue;
-    _values[k + 3] = 255;
-  }
 }
 
 Picture::Picture(const std::vector<std::vector<int>> &grays) {
@@ -32,82 +24,284 @@ Picture::Picture(const std::vector<std::vector<int>> &grays) {
     _width = 0;
     _height = 0;
   } else {
-    _values = std::vector<unsigned char>(grays[0].size() * grays.size() * 4);
     _width = grays[0].size();
     _height = grays.size();
-    int k = 0;
-    for (int y = 0; y < _height; y++)
+    _pixels = std::vector<uint32_t>(size_t(_width) * _height);
+    for (int y = 0; y < _height; y++) {
+      uint32_t *pixels = row(y);
       for (int x = 0; x < _width; x++) {
-        int gray = grays[y][x];
-        _values[k] = gray;
-        _values[k + 1] = gray;
-        _values[k + 2] = gray;
-        _values[k + 3] = 255;
-        k += 4;
+        const int gray = grays[y][x];
+        pixels[x] = pack({gray, gray, gray});
       }
+    }
   }
 }
 
 Picture::Picture(std::string filename) {
+  std::vector<unsigned char> values;
   unsigned int w, h;
-  unsigned error = lodepng::decode(_values, w, h, filename.c_str());
+  unsigned error = lodepng::decode(values, w, h, filename.c_str());
   if (error != 0)
     throw std::runtime_error(lodepng_error_text(error));
   _width = w;
   _height = h;
+  _pixels.resize(size_t(w) * h);
+  std::memcpy(_pixels.data(), values.data(), values.size());
 }
 
 void Picture::save(std::string filename) const {
-  unsigned error = lodepng::encode(filename.c_str(), _values, _width, _height);
+  PROFILE_SCOPE("Picture::save");
+  unsigned error;
+  if (_isIndexed) {
+    // indices are encoded as they are, against the same palette
+    lodepng::State state;
+    state.encoder.auto_convert = 0;
+    state.info_raw.colortype = LCT_PALETTE;
+    state.info_raw.bitdepth = 8;
+    state.info_png.color.colortype = LCT_PALETTE;
+    state.info_png.color.bitdepth = 8;
+    for (const uint32_t color : _palette) {
+      unsigned char rgba[4];
+      std::memcpy(rgba, &color, sizeof(rgba));
+      lodepng_palette_add(&state.info_raw, rgba[0], rgba[1], rgba[2], rgba[3]);
+      lodepng_palette_add(&state.info_png.color, rgba[0], rgba[1], rgba[2],
+                          rgba[3]);
+    }
+
+    std::vector<unsigned char> png;
+    error = lodepng::encode(png, _indices, _width, _height, state);
+    if (error == 0)
+      error = lodepng::save_file(png, filename);
+  } else {
+    error = lodepng::encode(filename.c_str(), bytes(), _width, _height);
+  }
   if (error != 0)
     throw std::runtime_error(lodepng_error_text(error));
 }
 
+void Picture::save(std::string filename, const PngOptions &options) const {
+  PROFILE_SCOPE("Picture::save");
+  const std::vector<unsigned char> png =
+      _isIndexed
+          ? encodeIndexedPng(_indices.data(), _palette, _width, _height,
+                             options)
+          : encodePng(bytes(), _width, _height, options);
+  unsigned error = lodepng::save_file(png, filename);
+  if (error != 0)
+    throw std::runtime_error(lodepng_error_text(error));
+}
+
+uint32_t Picture::pack(rgbColor color) {
+  const unsigned char rgba[4] = {
+      static_cast<unsigned char>(color.r), static_cast<unsigned char>(color.g),
+      static_cast<unsigned char>(color.b), 255};
+  uint32_t pixel;
+  std::memcpy(&pixel, rgba, sizeof(pixel));
+  return pixel;
+}
+
+rgbColor Picture::unpack(uint32_t pixel) {
+  unsigned char rgba[4];
+  std::memcpy(rgba, &pixel, sizeof(rgba));
+  return {rgba[0], rgba[1], rgba[2]};
+}
+
+bool Picture::setIndexed(bool isIndexed) {
+  if (isIndexed == _isIndexed)
+    return true;
+
+  if (!isIndexed) {
+    _pixels.resize(_indices.size());
+    for (size_t k = 0; k < _indices.size(); k++) {
+      _pixels[k] = _palette[_indices[k]];
+    }
+    std::vector<uint8_t>().swap(_indices);
+    _palette.clear();
+    _isIndexed = false;
+    return true;
+  }
+
+  _isIndexed = true;
+  _indices.resize(_pixels.size());
+  for (size_t k = 0; k < _pixels.size(); k++) {
+    const int index = indexOf(_pixels[k]);
+    if (index < 0) {
+      std::vector<uint8_t>().swap(_indices);
+      _palette.clear();
+      _isIndexed = false;
+      return false;
+    }
+    _indices[k] = index;
+  }
+  std::vector<uint32_t>().swap(_pixels);
+  return true;
+}
+
+/**
+   Yields the palette index of a packed color, adding it to the palette if
+   it is new, or -1 if the palette is full.
+ */
+int Picture::indexOf(uint32_t pixel) {
+  // most draws repeat the previous color
+  if (!_palette.empty() && _palette.back() == pixel)
+    return _palette.size() - 1;
+
+  const auto found = std::find(_palette.begin(), _palette.end(), pixel);
+  if (found != _palette.end())
+    return found - _palette.begin();
+  if (_palette.size() == 256)
+    return -1;
+  _palette.push_back(pixel);
+  return _palette.size() - 1;
+}
+
+uint32_t Picture::pixel(int x, int y) const {
+  const size_t k = size_t(y) * _width + x;
+  return _isIndexed ? _palette[_indices[k]] : _pixels[k];
+}
+
 int Picture::red(int x, int y) const {
   if (0 <= x && x < _width && 0 <= y && y < _height)
-    return _values[4 * (y * _width + x)];
+    return unpack(pixel(x, y)).r;
   else
     return 0;
 }
 
 int Picture::green(int x, int y) const {
   if (0 <= x && x < _width && 0 <= y && y < _height)
-    return _values[4 * (y * _width + x) + 1];
+    return unpack(pixel(x, y)).g;
   else
     return 0;
 }
 
 int Picture::blue(int x, int y) const {
   if (0 <= x && x < _width && 0 <= y && y < _height)
-    return _values[4 * (y * _width + x) + 2];
+    return unpack(pixel(x, y)).b;
   else
     return 0;
 }
 
 void Picture::set(int x, int y, rgbColor color) {
-  const int red = color.r;
-  const int green = color.g;
-  const int blue = color.b;
-
-  if (x >= 0 && y >= 0) {
+  if (x < 0 || y < 0)
+    return;
+  if (_isFixed) {
+    if (x >= _width || y >= _height)
+      return;
+  } else {
     ensure(x, y);
-    int k = 4 * (y * _width + x);
-    _values[k] = red;
-    _values[k + 1] = green;
-    _values[k + 2] = blue;
-    _values[k + 3] = 255;
+  }
+
+  const uint32_t packed = pack(color);
+  if (_isIndexed) {
+    const int index = indexOf(packed);
+    if (index >= 0) {
+      indexRow(y)[x] = index;
+      return;
+    }
+    setIndexed(false);
+  }
+  row(y)[x] = packed;
+}
+
+void Picture::plot(const std::vector<Point> &points, rgbColor color) {
+  const uint32_t pixel = pack(color);
+
+  // grow once for the whole batch
+  if (!_isFixed) {
+    int maxX = -1, maxY = -1;
+    for (const Point &p : points) {
+      maxX = std::max(maxX, p.x);
+      maxY = std::max(maxY, p.y);
+    }
+    if (maxX >= 0 && maxY >= 0)
+      ensure(maxX, maxY);
+  }
+
+  const int index = _isIndexed ? indexOf(pixel) : -1;
+  if (_isIndexed && index < 0)
+    setIndexed(false);
+
+  for (const Point &p : points) {
+    if (p.x >= 0 && p.y >= 0 && p.x < _width && p.y < _height) {
+      if (_isIndexed)
+        indexRow(p.y)[p.x] = index;
+      else
+        row(p.y)[p.x] = pixel;
+    }
+  }
+}
+
+void Picture::blend(const std::vector<Point> &points,
+                    const std::vector<float> &coverage, rgbColor color) {
+  if (!_isFixed) {
+    int maxX = -1, maxY = -1;
+    for (const Point &p : points) {
+      maxX = std::max(maxX, p.x);
+      maxY = std::max(maxY, p.y);
+    }
+    if (maxX >= 0 && maxY >= 0)
+      ensure(maxX, maxY);
+  }
+  setIndexed(false);
+
+  const float target[3] = {float(color.r), float(color.g), float(color.b)};
+  for (size_t i = 0; i < points.size(); i++) {
+    const Point &p = points[i];
+    if (p.x < 0 || p.y < 0 || p.x >= _width || p.y >= _height)
+      continue;
+
+    const float a = std::min(1.0f, std::max(0.0f, coverage[i]));
+    unsigned char rgba[4];
+    std::memcpy(rgba, &row(p.y)[p.x], sizeof(rgba));
+    for (int c = 0; c < 3; c++) {
+      rgba[c] = (unsigned char)(rgba[c] + (target[c] - rgba[c]) * a + 0.5f);
+    }
+    std::memcpy(&row(p.y)[p.x], rgba, sizeof(rgba));
+  }
+}
+
+void Picture::stamp(const std::vector<Point> &centers,
+                    const std::vector<rgbColor> &colors, int halfWidth) {
+  if (!_isFixed) {
+    int maxX = -1, maxY = -1;
+    for (const Point &c : centers) {
+      maxX = std::max(maxX, c.x + halfWidth);
+      maxY = std::max(maxY, c.y + halfWidth);
+    }
+    if (maxX >= 0 && maxY >= 0)
+      ensure(maxX, maxY);
+  }
+
+  for (size_t i = 0; i < centers.size(); i++) {
+    // clip the square once, then fill whole row spans
+    const int x0 = std::max(0, centers[i].x - halfWidth);
+    const int x1 = std::min(_width - 1, centers[i].x + halfWidth);
+    const int y0 = std::max(0, centers[i].y - halfWidth);
+    const int y1 = std::min(_height - 1, centers[i].y + halfWidth);
+    if (x0 > x1 || y0 > y1)
+      continue; // entirely off the canvas
+
+    const uint32_t pixel = pack(colors[i]);
+    const int index = _isIndexed ? indexOf(pixel) : -1;
+    if (_isIndexed && index < 0)
+      setIndexed(false);
+
+    for (int y = y0; y <= y1; y++) {
+      if (_isIndexed)
+        std::fill(indexRow(y) + x0, indexRow(y) + x1 + 1, uint8_t(index));
+      else
+        std::fill(row(y) + x0, row(y) + x1 + 1, pixel);
+    }
   }
 }
 
 void Picture::add(const Picture &other, int x, int y) {
   ensure(x + other._width - 1, y + other._height - 1);
-  int k = 0;
-  for (int dy = 0; dy < other._height; dy++)
+  for (int dy = 0; dy < other._height; dy++) {
     for (int dx = 0; dx < other._width; dx++) {
-      set(x + dx, y + dy,
-          {other._values[k], other._values[k + 1], other._values[k + 2]});
-      k += 4;
+      set(x + dx, y + dy, unpack(other.pixel(dx, dy)));
     }
+  }
 }
 
 std::vector<std::vector<int>> Picture::grays() const {
@@ -115,54 +309,162 @@ std::vector<std::vector<int>> Picture::grays() const {
   for (int y = 0; y < _height; y++) {
     result[y] = std::vector<int>(_width);
     for (int x = 0; x < _width; x++) {
-      int k = 4 * (y * _width + x);
-      result[y][x] = (int)(0.2126 * _values[k] + 0.7152 * _values[k + 1] +
-                           0.0722 * _values[k + 2]);
+      const rgbColor c = unpack(pixel(x, y));
+      result[y][x] = (int)(0.2126 * c.r + 0.7152 * c.g + 0.0722 * c.b);
     }
   }
   return result;
 }
 
-void Picture::scale(const size_t factor) {
-  const size_t channels = 4;
+// Runs rows(begin, end) over [first, last) split into one chunk per thread,
+// the calling thread taking the first chunk
+template <typename Rows>
+void forRows(size_t first, size_t last, unsigned threadCount, Rows rows) {
+  if (last <= first)
+    return;
+  threadCount = std::max(1u, std::min<unsigned>(threadCount, last - first));
+  const size_t chunkSize = (last - first + threadCount - 1) / threadCount;
 
-  const size_t height = static_cast<size_t>(_height);
-  const size_t width = static_cast<size_t>(_width);
+  std::vector<std::thread> workers;
+  for (size_t begin = first + chunkSize; begin < last; begin += chunkSize) {
+    workers.emplace_back(rows, begin, std::min(begin + chunkSize, last));
+  }
+  rows(first, std::min(first + chunkSize, last));
 
-  const size_t dstWidth = _width * factor * channels;
-  const size_t dstHeight = _height * factor * channels;
+  for (std::thread &t : workers) {
+    t.join();
+  }
+}
 
-  std::vector<unsigned char> newValues(_values.size() * factor * factor);
+// Repeats every pixel of a width x height buffer factor times in both axes,
+// in place. Rows are expanded bottom up in waves: the destination of every
+// row of a wave lies past the source rows still waiting, and past the other
+// source rows of the wave, so a wave's rows run in parallel. Row 0 overlaps
+// its own destination and is expanded right to left on its own
+template <typename T>
+void scaleBuffer(std::vector<T> &values, size_t width, size_t height,
+                 size_t factor, unsigned threadCount) {
+  const size_t dstWidth = width * factor;
+  values.resize(dstWidth * height * factor);
+  T *data = values.data();
 
-  for (size_t j = 0; j < height; j++) {
-    const size_t srcRowIdx = j * width * channels;
-    const size_t dstRowIdx = j * factor * dstWidth;
+  auto expand = [=](size_t begin, size_t end) {
+    for (size_t j = end; j-- > begin;) {
+      const T *srcRow = data + j * width;
+      T *dstRow = data + j * factor * dstWidth;
+      for (size_t i = width; i-- > 0;) {
+        const T value = srcRow[i];
+        std::fill(dstRow + i * factor, dstRow + (i + 1) * factor, value);
+      }
+      for (size_t x = 1; x < factor; x++) {
+        std::memcpy(dstRow + x * dstWidth, dstRow, dstWidth * sizeof(T));
+      }
+    }
+  };
 
-    // Create a temporary row that we can copy multiple times
-    std::vector<unsigned char> tempRow(dstWidth);
+  const size_t area = factor * factor;
+  for (size_t hi = height; hi > 1;) {
+    const size_t lo = std::max<size_t>(1, (hi + area - 1) / area);
+    forRows(lo, hi, threadCount, expand);
+    hi = lo;
+  }
+  if (height > 0)
+    expand(0, 1);
+}
+
+void Picture::scale(const size_t factor, unsigned threadCount) {
+  if (factor < 2)
+    return;
+  if (_isIndexed)
+    scaleBuffer(_indices, _width, _height, factor, threadCount);
+  else
+    scaleBuffer(_pixels, _width, _height, factor, threadCount);
+  _width *= factor;
+  _height *= factor;
+}
 
-    // Build first row 'manually'
-    for (size_t i = 0; i < width; i++) {
-      const size_t srcPixelIdx = srcRowIdx + i * channels;
-      const size_t dstPixelIdx = i * factor * channels;
+// Averages every factor x factor block of a width x height buffer of packed
+// pixels into one, in place, dropping edge pixels that do not fill a block.
+// Destination rows are written top down in waves: every row of a wave
+// overwrites only source rows of earlier waves, so a wave's rows run in
+// parallel. Each destination row first sums its source rows byte by byte, a
+// loop the compiler vectorizes, then adds up each block's columns
+void downsampleBuffer(std::vector<uint32_t> &pixels, size_t width,
+                      size_t height, size_t factor, unsigned threadCount) {
+  const size_t dstWidth = width / factor;
+  const size_t dstHeight = height / factor;
+  const uint32_t area = factor * factor;
+  uint32_t *data = pixels.data();
 
-      // Copy the pixel "factor" times
-      for (size_t k = 0; k < factor; k++) {
-        std::memcpy(tempRow.data() + dstPixelIdx + k * channels,
-                    _values.data() + srcPixelIdx, channels);
+  auto average = [=](size_t begin, size_t end) {
+    // column sums of every byte of a destination row's source rows
+    std::vector<uint32_t> sums(dstWidth * factor * 4);
+    for (size_t j = begin; j < end; j++) {
+      std::fill(sums.begin(), sums.end(), 0);
+      for (size_t dy = 0; dy < factor; dy++) {
+        const unsigned char *src = reinterpret_cast<const unsigned char *>(
+            data + (j * factor + dy) * width);
+        for (size_t k = 0; k < sums.size(); k++) {
+          sums[k] += src[k];
+        }
       }
-    }
 
-    // Copy the temporary row "factor" times
-    for (size_t x = 0; x < factor; x++) {
-      std::memcpy(newValues.data() + dstRowIdx + x * dstWidth, tempRow.data(),
-                  tempRow.size());
+      uint32_t *dstRow = data + j * dstWidth;
+      for (size_t i = 0; i < dstWidth; i++) {
+        uint32_t block[4] = {0, 0, 0, 0};
+        const uint32_t *column = sums.data() + i * factor * 4;
+        for (size_t dx = 0; dx < factor; dx++) {
+          for (int c = 0; c < 4; c++) {
+            block[c] += column[dx * 4 + c];
+          }
+        }
+        unsigned char rgba[4];
+        for (int c = 0; c < 4; c++) {
+          rgba[c] = (block[c] + area / 2) / area;
+        }
+        std::memcpy(dstRow + i, rgba, sizeof(rgba));
+      }
     }
+  };
+
+  if (dstHeight > 0)
+    average(0, 1);
+  for (size_t lo = 1; lo < dstHeight;) {
+    const size_t hi = std::min(dstHeight, lo * area);
+    forRows(lo, hi, threadCount, average);
+    lo = hi;
   }
 
-  _width = dstWidth / channels;
-  _height = dstHeight / channels;
-  _values.swap(newValues);
+  pixels.resize(dstWidth * dstHeight);
+}
+
+void Picture::downsample(const size_t factor, unsigned threadCount) {
+  if (factor < 2)
+    return;
+  PROFILE_SCOPE("Picture::downsample");
+  // averages are new colors
+  setIndexed(false);
+  downsampleBuffer(_pixels, _width, _height, factor, threadCount);
+  _width /= factor;
+  _height /= factor;
+}
+
+void Picture::reserve(int width, int height) {
+  if (_isIndexed)
+    _indices.reserve(size_t(width) * height);
+  else
+    _pixels.reserve(size_t(width) * height);
+}
+
+// copies a width x height buffer into the top left of a larger one
+template <typename T>
+void growBuffer(std::vector<T> &values, int width, int height, int newWidth,
+                int newHeight, T fill) {
+  std::vector<T> grown(size_t(newWidth) * newHeight, fill);
+  for (int dy = 0; dy < height; dy++)
+    std::memcpy(grown.data() + size_t(dy) * newWidth,
+                values.data() + size_t(dy) * width, width * sizeof(T));
+  values.swap(grown);
 }
 
 /**
@@ -172,14 +474,15 @@ void Picture::ensure(int x, int y) {
   if (x >= _width || y >= _height) {
     int new_width = std::max(x + 1, _width);
     int new_height = std::max(y + 1, _height);
-    std::vector<unsigned char> new_values(4 * new_width * new_height);
-    fill(new_values.begin(), new_values.end(), 255); // fill with white
-    int j = 0;
-    for (int dy = 0; dy < _height; dy++)
-      for (int dx = 0; dx < _width; dx++)
-        for (int k = 0; k < 4; k++, j++)
-          new_values[4 * (dy * new_width + dx) + k] = _values[j];
-    _values.swap(new_values);
+    // fill with white
+    const uint32_t white = pack({255, 255, 255});
+    if (_isIndexed && indexOf(white) < 0)
+      setIndexed(false);
+    if (_isIndexed)
+      growBuffer(_indices, _width, _height, new_width, new_height,
+                 uint8_t(indexOf(white)));
+    else
+      growBuffer(_pixels, _width, _height, new_width, new_height, white);
     _width = new_width;
     _height = new_height;
   }
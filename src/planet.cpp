@@ -0,0 +1,60 @@
+#include "../include/planet.h"
+
+#include <deque>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <unordered_map>
+
+
+// every interned name, looked up both ways
+struct NameTable {
+  std::deque<std::string> names{""};
+  std::unordered_map<std::string, BodyId> ids{{"", 0}};
+  std::shared_mutex mutex;
+};
+
+
+NameTable &nameTable() {
+  static NameTable table;
+  return table;
+}
+
+
+// id of name, interning it if it is new. Safe to call from several threads
+BodyId internName(const std::string &name) {
+  NameTable &table = nameTable();
+  {
+    std::shared_lock<std::shared_mutex> lock(table.mutex);
+    const auto found = table.ids.find(name);
+    if (found != table.ids.end())
+      return found->second;
+  }
+
+  std::unique_lock<std::shared_mutex> lock(table.mutex);
+  const auto inserted = table.ids.emplace(name, table.names.size());
+  if (inserted.second)
+    table.names.push_back(name);
+  return inserted.first->second;
+}
+
+
+// id of an already interned name, false if it was never interned
+bool findBodyId(const std::string &name, BodyId &id) {
+  NameTable &table = nameTable();
+  std::shared_lock<std::shared_mutex> lock(table.mutex);
+  const auto found = table.ids.find(name);
+  if (found == table.ids.end())
+    return false;
+  id = found->second;
+  return true;
+}
+
+
+// name of an interned id, throws std::out_of_range if there is none. Names
+// never move once interned, so the reference stays valid
+const std::string &bodyName(BodyId id) {
+  NameTable &table = nameTable();
+  std::shared_lock<std::shared_mutex> lock(table.mutex);
+  return table.names.at(id);
+}
@@ -0,0 +1,761 @@
+#include "../include/png.h"
+#include "../include/lodepng.h"
+#include "../include/profile.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+
+// returns the filter with the given name, throws std::invalid_argument if
+// none
+PngFilter parsePngFilter(const std::string &name) {
+  if (name == "none")
+    return PngFilter::None;
+  if (name == "sub")
+    return PngFilter::Sub;
+  if (name == "up")
+    return PngFilter::Up;
+  if (name == "average")
+    return PngFilter::Average;
+  if (name == "paeth")
+    return PngFilter::Paeth;
+  if (name == "adaptive")
+    return PngFilter::Adaptive;
+  throw std::invalid_argument("Unknown PNG filter \"" + name + "\"");
+}
+
+
+// Writes deflate's least significant bit first bit stream
+class BitWriter {
+public:
+  explicit BitWriter(std::vector<unsigned char> &out) : _out(out) {}
+
+  void write(uint32_t bits, int count) {
+    _buffer |= uint64_t(bits) << _count;
+    _count += count;
+    while (_count >= 8) {
+      _out.push_back(_buffer & 0xff);
+      _buffer >>= 8;
+      _count -= 8;
+    }
+  }
+
+  // Huffman codes are stored most significant bit first
+  void writeCode(uint32_t code, int length) {
+    uint32_t reversed = 0;
+    for (int i = 0; i < length; i++) {
+      reversed = (reversed << 1) | ((code >> i) & 1);
+    }
+    write(reversed, length);
+  }
+
+  void alignToByte() {
+    if (_count > 0)
+      write(0, 8 - _count);
+  }
+
+private:
+  std::vector<unsigned char> &_out;
+  uint64_t _buffer = 0;
+  int _count = 0;
+};
+
+
+const int kMinMatch = 3;
+const int kMaxMatch = 258;
+const int kWindowSize = 32768;
+const int kHashBits = 15;
+
+const int kLengthBase[29] = {3,  4,  5,  6,  7,  8,  9,  10, 11,  13,
+                             15, 17, 19, 23, 27, 31, 35, 43, 51,  59,
+                             67, 83, 99, 115, 131, 163, 195, 227, 258};
+const int kLengthExtra[29] = {0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2,
+                              2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0};
+const int kDistanceBase[30] = {1,    2,    3,    4,    5,    7,     9,
+                               13,   17,   25,   33,   49,   65,    97,
+                               129,  193,  257,  385,  513,  769,   1025,
+                               1537, 2049, 3073, 4097, 6145, 8193,  12289,
+                               16385, 24577};
+const int kDistanceExtra[30] = {0, 0, 0, 0, 1, 1, 2,  2,  3,  3,
+                                4, 4, 5, 5, 6, 6, 7,  7,  8,  8,
+                                9, 9, 10, 10, 11, 11, 12, 12, 13, 13};
+
+
+// Code lengths of a Huffman code for the given symbol frequencies, none longer
+// than maxLength. Frequencies are halved until the tree is shallow enough.
+// At least two symbols get a code, so the code is always complete
+std::vector<int> huffmanLengths(std::vector<uint32_t> frequencies,
+                                int maxLength) {
+  const size_t n = frequencies.size();
+  std::vector<int> lengths(n, 0);
+
+  size_t used = std::count_if(frequencies.begin(), frequencies.end(),
+                              [](uint32_t f) { return f > 0; });
+  for (size_t i = 0; used < 2 && i < n; i++) {
+    if (frequencies[i] == 0) {
+      frequencies[i] = 1;
+      used++;
+    }
+  }
+
+  while (true) {
+    // nodes 0..n-1 are leaves, later nodes are merged pairs
+    std::vector<uint64_t> weight(frequencies.begin(), frequencies.end());
+    std::vector<int> parent(n, -1);
+    std::vector<std::pair<uint64_t, int>> heap;
+    for (size_t i = 0; i < n; i++) {
+      if (weight[i] > 0)
+        heap.emplace_back(weight[i], i);
+    }
+    auto greater = [](const std::pair<uint64_t, int> &a,
+                      const std::pair<uint64_t, int> &b) { return a > b; };
+    std::make_heap(heap.begin(), heap.end(), greater);
+
+    while (heap.size() > 1) {
+      std::pop_heap(heap.begin(), heap.end(), greater);
+      const auto a = heap.back();
+      heap.pop_back();
+      std::pop_heap(heap.begin(), heap.end(), greater);
+      const auto b = heap.back();
+      heap.pop_back();
+
+      const int node = weight.size();
+      weight.push_back(a.first + b.first);
+      parent.push_back(-1);
+      parent[a.second] = node;
+      parent[b.second] = node;
+      heap.emplace_back(a.first + b.first, node);
+      std::push_heap(heap.begin(), heap.end(), greater);
+    }
+
+    int longest = 0;
+    for (size_t i = 0; i < n; i++) {
+      if (frequencies[i] == 0) {
+        lengths[i] = 0;
+        continue;
+      }
+      int depth = 0;
+      for (int node = i; parent[node] >= 0; node = parent[node])
+        depth++;
+      lengths[i] = depth;
+      longest = std::max(longest, depth);
+    }
+
+    if (longest <= maxLength)
+      return lengths;
+    for (uint32_t &f : frequencies) {
+      if (f > 0)
+        f = (f + 1) / 2;
+    }
+  }
+}
+
+
+// canonical codes for the given code lengths, as deflate assigns them
+std::vector<uint32_t> canonicalCodes(const std::vector<int> &lengths) {
+  int longest = *std::max_element(lengths.begin(), lengths.end());
+  std::vector<uint32_t> count(longest + 1, 0), next(longest + 2, 0);
+  for (const int length : lengths) {
+    if (length > 0)
+      count[length]++;
+  }
+  uint32_t code = 0;
+  for (int length = 1; length <= longest; length++) {
+    code = (code + count[length - 1]) << 1;
+    next[length] = code;
+  }
+  std::vector<uint32_t> codes(lengths.size(), 0);
+  for (size_t i = 0; i < lengths.size(); i++) {
+    if (lengths[i] > 0)
+      codes[i] = next[lengths[i]]++;
+  }
+  return codes;
+}
+
+
+// literal, or match length and distance, found by LZ77
+struct Token {
+  uint16_t length; // 0 for a literal
+  uint16_t value;  // the literal byte, or the match distance
+};
+
+
+int lengthSymbol(int length) {
+  return std::upper_bound(kLengthBase, kLengthBase + 29, length) -
+         kLengthBase - 1;
+}
+
+
+int distanceSymbol(int distance) {
+  return std::upper_bound(kDistanceBase, kDistanceBase + 30, distance) -
+         kDistanceBase - 1;
+}
+
+
+// Writes tokens as one block with Huffman codes built for them
+void writeDynamicBlock(BitWriter &bits, const std::vector<Token> &tokens,
+                       bool isFinal) {
+  std::vector<uint32_t> literalFrequencies(286, 0), distanceFrequencies(30, 0);
+  for (const Token &t : tokens) {
+    if (t.length == 0) {
+      literalFrequencies[t.value]++;
+    } else {
+      literalFrequencies[257 + lengthSymbol(t.length)]++;
+      distanceFrequencies[distanceSymbol(t.value)]++;
+    }
+  }
+  literalFrequencies[256] = 1;
+
+  const std::vector<int> literalLengths =
+      huffmanLengths(literalFrequencies, 15);
+  const std::vector<int> distanceLengths =
+      huffmanLengths(distanceFrequencies, 15);
+  const std::vector<uint32_t> literalCodes = canonicalCodes(literalLengths);
+  const std::vector<uint32_t> distanceCodes = canonicalCodes(distanceLengths);
+
+  int literalCount = 286, distanceCount = 30;
+  while (literalCount > 257 && literalLengths[literalCount - 1] == 0)
+    literalCount--;
+  while (distanceCount > 1 && distanceLengths[distanceCount - 1] == 0)
+    distanceCount--;
+
+  // both code length lists, run length encoded with symbols 16, 17 and 18
+  std::vector<int> lengths(literalLengths.begin(),
+                           literalLengths.begin() + literalCount);
+  lengths.insert(lengths.end(), distanceLengths.begin(),
+                 distanceLengths.begin() + distanceCount);
+
+  std::vector<std::pair<int, int>> runs; // symbol, extra bits value
+  for (size_t i = 0; i < lengths.size();) {
+    size_t run = 1;
+    while (i + run < lengths.size() && lengths[i + run] == lengths[i])
+      run++;
+
+    if (lengths[i] == 0 && run >= 3) {
+      run = std::min<size_t>(run, 138);
+      if (run <= 10)
+        runs.emplace_back(17, run - 3);
+      else
+        runs.emplace_back(18, run - 11);
+    } else if (lengths[i] != 0 && run >= 4) {
+      run = std::min<size_t>(run, 7);
+      runs.emplace_back(lengths[i], 0);
+      runs.emplace_back(16, run - 4);
+    } else {
+      run = 1;
+      runs.emplace_back(lengths[i], 0);
+    }
+    i += run;
+  }
+
+  std::vector<uint32_t> lengthFrequencies(19, 0);
+  for (const auto &r : runs) {
+    lengthFrequencies[r.first]++;
+  }
+  const std::vector<int> lengthLengths = huffmanLengths(lengthFrequencies, 7);
+  const std::vector<uint32_t> lengthCodes = canonicalCodes(lengthLengths);
+
+  const int order[19] = {16, 17, 18, 0, 8, 7, 9, 6, 10, 5,
+                         11, 4, 12, 3, 13, 2, 14, 1, 15};
+  int lengthCount = 19;
+  while (lengthCount > 4 && lengthLengths[order[lengthCount - 1]] == 0)
+    lengthCount--;
+
+  bits.write(isFinal, 1);
+  bits.write(2, 2);
+  bits.write(literalCount - 257, 5);
+  bits.write(distanceCount - 1, 5);
+  bits.write(lengthCount - 4, 4);
+  for (int i = 0; i < lengthCount; i++) {
+    bits.write(lengthLengths[order[i]], 3);
+  }
+  for (const auto &r : runs) {
+    bits.writeCode(lengthCodes[r.first], lengthLengths[r.first]);
+    if (r.first == 16)
+      bits.write(r.second, 2);
+    else if (r.first == 17)
+      bits.write(r.second, 3);
+    else if (r.first == 18)
+      bits.write(r.second, 7);
+  }
+
+  for (const Token &t : tokens) {
+    if (t.length == 0) {
+      bits.writeCode(literalCodes[t.value], literalLengths[t.value]);
+      continue;
+    }
+    const int l = lengthSymbol(t.length);
+    bits.writeCode(literalCodes[257 + l], literalLengths[257 + l]);
+    bits.write(t.length - kLengthBase[l], kLengthExtra[l]);
+    const int d = distanceSymbol(t.value);
+    bits.writeCode(distanceCodes[d], distanceLengths[d]);
+    bits.write(t.value - kDistanceBase[d], kDistanceExtra[d]);
+  }
+  bits.writeCode(literalCodes[256], literalLengths[256]);
+}
+
+
+// tokens per Huffman block, so codes adapt along the strip
+const size_t kBlockTokens = 1 << 16;
+
+
+// Deflates data into out, in stored blocks at level 0 and otherwise in blocks
+// with their own Huffman codes. Unless isLast, the strip ends with an empty
+// stored block instead of a final block, leaving the stream open and byte
+// aligned for the next strip
+void deflateStrip(const std::vector<unsigned char> &data, int level,
+                  bool isLast, std::vector<unsigned char> &out) {
+  BitWriter bits(out);
+
+  if (level == 0) {
+    size_t begin = 0;
+    do {
+      const size_t size = std::min<size_t>(65535, data.size() - begin);
+      const bool isFinal = isLast && begin + size == data.size();
+      bits.write(isFinal, 1);
+      bits.write(0, 2);
+      bits.alignToByte();
+      bits.write(size, 16);
+      bits.write(~size & 0xffff, 16);
+      out.insert(out.end(), data.begin() + begin, data.begin() + begin + size);
+      begin += size;
+    } while (begin < data.size());
+    return;
+  }
+
+  // greedy matching through hash chains, longer chains at higher levels
+  const int maxChain = 1 << (level - 1);
+  std::vector<int32_t> head(1 << kHashBits, -1);
+  std::vector<int32_t> previous(kWindowSize, -1);
+  auto hash = [&data](size_t i) {
+    return ((data[i] << 10) ^ (data[i + 1] << 5) ^ data[i + 2]) &
+           ((1 << kHashBits) - 1);
+  };
+  auto insert = [&](size_t i) {
+    const uint32_t h = hash(i);
+    previous[i % kWindowSize] = head[h];
+    head[h] = i;
+  };
+
+  std::vector<Token> tokens;
+  tokens.reserve(std::min(kBlockTokens, data.size() + 1));
+
+  const size_t size = data.size();
+  size_t i = 0;
+  while (i < size) {
+    int bestLength = 0, bestDistance = 0;
+
+    if (i + kMinMatch <= size) {
+      const size_t limit = std::min<size_t>(kMaxMatch, size - i);
+      int32_t candidate = head[hash(i)];
+      for (int chain = 0; chain < maxChain && candidate >= 0 &&
+                          i - candidate <= size_t(kWindowSize);
+           chain++) {
+        size_t length = 0;
+        while (length < limit && data[candidate + length] == data[i + length])
+          length++;
+        if (int(length) > bestLength) {
+          bestLength = length;
+          bestDistance = i - candidate;
+          if (length == limit)
+            break;
+        }
+        candidate = previous[candidate % kWindowSize];
+      }
+      insert(i);
+    }
+
+    if (bestLength >= kMinMatch) {
+      tokens.push_back({uint16_t(bestLength), uint16_t(bestDistance)});
+      for (size_t j = i + 1; j < i + bestLength && j + kMinMatch <= size; j++)
+        insert(j);
+      i += bestLength;
+    } else {
+      tokens.push_back({0, data[i]});
+      i++;
+    }
+
+    if (tokens.size() == kBlockTokens && i < size) {
+      writeDynamicBlock(bits, tokens, false);
+      tokens.clear();
+    }
+  }
+
+  writeDynamicBlock(bits, tokens, isLast);
+
+  if (isLast) {
+    bits.alignToByte();
+  } else {
+    // sync flush
+    bits.write(0, 3);
+    bits.alignToByte();
+    bits.write(0, 16);
+    bits.write(0xffff, 16);
+  }
+}
+
+
+const uint32_t kAdlerBase = 65521;
+
+uint32_t adler32(const unsigned char *data, size_t size) {
+  uint32_t a = 1, b = 0;
+  while (size > 0) {
+    // largest run that cannot overflow before reducing
+    const size_t run = std::min<size_t>(size, 5552);
+    for (size_t i = 0; i < run; i++) {
+      a += data[i];
+      b += a;
+    }
+    a %= kAdlerBase;
+    b %= kAdlerBase;
+    data += run;
+    size -= run;
+  }
+  return (b << 16) | a;
+}
+
+
+// checksum of two buffers joined, from the checksum of each
+uint32_t adler32Combine(uint32_t first, uint32_t second, size_t secondSize) {
+  const uint64_t remainder = secondSize % kAdlerBase;
+  const uint64_t a1 = first & 0xffff, b1 = first >> 16;
+  const uint64_t a2 = second & 0xffff, b2 = second >> 16;
+
+  const uint64_t a = (a1 + a2 + kAdlerBase - 1) % kAdlerBase;
+  const uint64_t b =
+      (b1 + b2 + remainder * a1 + kAdlerBase - remainder) % kAdlerBase;
+  return uint32_t((b << 16) | a);
+}
+
+
+unsigned char paeth(int a, int b, int c) {
+  const int p = a + b - c;
+  const int pa = std::abs(p - a), pb = std::abs(p - b), pc = std::abs(p - c);
+  if (pa <= pb && pa <= pc)
+    return a;
+  return pb <= pc ? b : c;
+}
+
+
+// Filters one row of channels-byte pixels into out, prefixed by its filter
+// type. previous is the row above, or null for the first row
+void filterRow(const unsigned char *row, const unsigned char *previous,
+               size_t rowBytes, int channels, PngFilter filter,
+               unsigned char *out) {
+  if (filter == PngFilter::Adaptive) {
+    // smallest sum of filtered bytes taken as signed, like lodepng's minsum
+    thread_local std::vector<unsigned char> trial;
+    trial.resize(rowBytes + 1);
+    size_t bestSum = SIZE_MAX;
+    for (PngFilter f : {PngFilter::None, PngFilter::Sub, PngFilter::Up,
+                        PngFilter::Average, PngFilter::Paeth}) {
+      filterRow(row, previous, rowBytes, channels, f, trial.data());
+      size_t sum = 0;
+      for (size_t i = 1; i <= rowBytes; i++) {
+        sum += trial[i] < 128 ? trial[i] : 256 - trial[i];
+      }
+      if (sum < bestSum) {
+        bestSum = sum;
+        std::copy(trial.begin(), trial.end(), out);
+      }
+    }
+    return;
+  }
+
+  out[0] = static_cast<unsigned char>(filter);
+  unsigned char *filtered = out + 1;
+  for (size_t i = 0; i < rowBytes; i++) {
+    const int left = i >= size_t(channels) ? row[i - channels] : 0;
+    const int up = previous ? previous[i] : 0;
+    const int upLeft =
+        previous && i >= size_t(channels) ? previous[i - channels] : 0;
+    switch (filter) {
+    case PngFilter::None:
+      filtered[i] = row[i];
+      break;
+    case PngFilter::Sub:
+      filtered[i] = row[i] - left;
+      break;
+    case PngFilter::Up:
+      filtered[i] = row[i] - up;
+      break;
+    case PngFilter::Average:
+      filtered[i] = row[i] - (left + up) / 2;
+      break;
+    case PngFilter::Paeth:
+      filtered[i] = row[i] - paeth(left, up, upLeft);
+      break;
+    case PngFilter::Adaptive:
+      break;
+    }
+  }
+}
+
+
+void appendBigEndian(std::vector<unsigned char> &out, uint32_t value) {
+  for (int shift = 24; shift >= 0; shift -= 8) {
+    out.push_back((value >> shift) & 0xff);
+  }
+}
+
+
+void appendChunk(std::vector<unsigned char> &png, const char *type,
+                 const std::vector<unsigned char> &data) {
+  appendBigEndian(png, data.size());
+  const size_t typeStart = png.size();
+  png.insert(png.end(), type, type + 4);
+  png.insert(png.end(), data.begin(), data.end());
+  appendBigEndian(png, lodepng_crc32(&png[typeStart], data.size() + 4));
+}
+
+
+// Filters and deflates rows first to last - 1 of rowBytes bytes, read by
+// readRow, in one strip per thread, appending the deflate data to out and
+// returning the Adler-32 of the filtered rows. Row first - 1, when there is
+// one, is read as the previous row of the first. Unless isLast, the data ends
+// on a byte boundary without a final block, so more rows can follow
+uint32_t
+deflateRows(unsigned first, unsigned last, size_t rowBytes, int channels,
+            const std::function<void(unsigned, unsigned char *)> &readRow,
+            const PngOptions &options, bool isLast,
+            std::vector<unsigned char> &out) {
+  if (options.level < 0 || options.level > 9)
+    throw std::invalid_argument("PNG level must be between 0 and 9");
+
+  const unsigned height = last - first;
+  const unsigned stripCount =
+      std::max(1u, std::min(options.threads, std::max(height, 1u)));
+  const unsigned rowsPerStrip = (height + stripCount - 1) / stripCount;
+
+  std::vector<std::vector<unsigned char>> compressed(stripCount);
+  std::vector<uint32_t> checksums(stripCount);
+  std::vector<size_t> sizes(stripCount);
+
+  // filters and deflates the rows of one strip
+  auto worker = [&](unsigned strip) {
+    PROFILE_SCOPE("png.strip");
+    const unsigned begin = std::min(last, first + strip * rowsPerStrip);
+    const unsigned end = std::min(last, begin + rowsPerStrip);
+
+    std::vector<unsigned char> filtered((end - begin) * (rowBytes + 1));
+    std::vector<unsigned char> row(rowBytes), previous(rowBytes);
+
+    if (begin > 0)
+      readRow(begin - 1, previous.data());
+    for (unsigned y = begin; y < end; y++) {
+      readRow(y, row.data());
+      filterRow(row.data(), y > 0 ? previous.data() : nullptr, rowBytes,
+                channels, options.filter,
+                filtered.data() + (y - begin) * (rowBytes + 1));
+      row.swap(previous);
+    }
+
+    checksums[strip] = adler32(filtered.data(), filtered.size());
+    sizes[strip] = filtered.size();
+    deflateStrip(filtered, options.level, isLast && strip + 1 == stripCount,
+                 compressed[strip]);
+  };
+
+  std::vector<std::thread> workers;
+  for (unsigned strip = 1; strip < stripCount; strip++) {
+    workers.emplace_back(worker, strip);
+  }
+  worker(0);
+  for (std::thread &t : workers) {
+    t.join();
+  }
+
+  // every strip in order, checksum of the whole
+  uint32_t checksum = checksums[0];
+  for (unsigned strip = 0; strip < stripCount; strip++) {
+    out.insert(out.end(), compressed[strip].begin(), compressed[strip].end());
+    if (strip > 0)
+      checksum = adler32Combine(checksum, checksums[strip], sizes[strip]);
+  }
+  return checksum;
+}
+
+
+// Filters and deflates height rows of rowBytes bytes, read by readRow, in
+// one strip per thread, returning the zlib stream
+std::vector<unsigned char>
+compressRows(unsigned height, size_t rowBytes, int channels,
+             const std::function<void(unsigned, unsigned char *)> &readRow,
+             const PngOptions &options) {
+  std::vector<unsigned char> zlib = {0x78, 0x01};
+  const uint32_t checksum =
+      deflateRows(0, height, rowBytes, channels, readRow, options, true, zlib);
+  appendBigEndian(zlib, checksum);
+  return zlib;
+}
+
+
+// IHDR data of width x height 8-bit pixels of the given color type
+std::vector<unsigned char> headerChunk(unsigned width, unsigned height,
+                                       unsigned char colorType) {
+  std::vector<unsigned char> header;
+  appendBigEndian(header, width);
+  appendBigEndian(header, height);
+  header.push_back(8);         // bit depth
+  header.push_back(colorType); // 2 RGB, 3 palette, 6 RGBA
+  header.push_back(0);         // deflate
+  header.push_back(0);         // adaptive filtering
+  header.push_back(0);         // not interlaced
+  return header;
+}
+
+
+// PNG file of width x height 8-bit pixels of the given color type, with the
+// given chunks between the header and the image data
+std::vector<unsigned char> assemblePng(
+    unsigned width, unsigned height, unsigned char colorType,
+    const std::vector<std::pair<const char *, std::vector<unsigned char>>>
+        &chunks,
+    const std::vector<unsigned char> &zlib) {
+  std::vector<unsigned char> png = {137, 80, 78, 71, 13, 10, 26, 10};
+  appendChunk(png, "IHDR", headerChunk(width, height, colorType));
+  for (const auto &chunk : chunks) {
+    appendChunk(png, chunk.first, chunk.second);
+  }
+  appendChunk(png, "IDAT", zlib);
+  appendChunk(png, "IEND", {});
+  return png;
+}
+
+
+std::vector<unsigned char> encodePng(const unsigned char *rgba, unsigned width,
+                                     unsigned height,
+                                     const PngOptions &options) {
+  const size_t pixelCount = size_t(width) * height;
+  bool isOpaque = true;
+  for (size_t k = 0; k < pixelCount && isOpaque; k++) {
+    isOpaque = rgba[4 * k + 3] == 255;
+  }
+  const int channels = isOpaque ? 3 : 4;
+
+  auto readRow = [&](unsigned y, unsigned char *dst) {
+    const unsigned char *src = rgba + size_t(y) * width * 4;
+    for (size_t x = 0; x < width; x++) {
+      for (int c = 0; c < channels; c++) {
+        dst[x * channels + c] = src[4 * x + c];
+      }
+    }
+  };
+
+  return assemblePng(
+      width, height, isOpaque ? 2 : 6, {},
+      compressRows(height, size_t(width) * channels, channels, readRow,
+                   options));
+}
+
+
+std::vector<unsigned char>
+encodeIndexedPng(const unsigned char *indices,
+                 const std::vector<uint32_t> &palette, unsigned width,
+                 unsigned height, const PngOptions &options) {
+  if (palette.empty() || palette.size() > 256)
+    throw std::invalid_argument("PNG palette must hold 1 to 256 colors");
+
+  // PLTE holds the colors, tRNS their alpha when any is transparent
+  std::vector<unsigned char> colors, alphas;
+  bool isOpaque = true;
+  for (const uint32_t color : palette) {
+    unsigned char rgba[4];
+    std::memcpy(rgba, &color, sizeof(rgba));
+    colors.insert(colors.end(), rgba, rgba + 3);
+    alphas.push_back(rgba[3]);
+    isOpaque = isOpaque && rgba[3] == 255;
+  }
+  std::vector<std::pair<const char *, std::vector<unsigned char>>> chunks = {
+      {"PLTE", colors}};
+  if (!isOpaque)
+    chunks.emplace_back("tRNS", alphas);
+
+  auto readRow = [&](unsigned y, unsigned char *dst) {
+    std::memcpy(dst, indices + size_t(y) * width, width);
+  };
+
+  return assemblePng(width, height, 3, chunks,
+                     compressRows(height, width, 1, readRow, options));
+}
+
+
+PngStream::PngStream(const std::string &filename, unsigned width,
+                     unsigned height, const PngOptions &options)
+    : _file(filename, std::ios::binary), _filename(filename), _width(width),
+      _height(height), _options(options), _previous(size_t(width) * 3) {
+  if (!_file)
+    throw std::runtime_error("Could not open " + filename + "\n");
+
+  std::vector<unsigned char> png = {137, 80, 78, 71, 13, 10, 26, 10};
+  appendChunk(png, "IHDR", headerChunk(width, height, 2));
+  writeBytes(png);
+}
+
+
+void PngStream::write(const unsigned char *rgba, unsigned rows) {
+  if (_rowsWritten + rows > _height)
+    throw std::logic_error("PNG stream given more rows than its height");
+
+  const unsigned first = _rowsWritten;
+  auto readRow = [&](unsigned y, unsigned char *dst) {
+    if (y < first) {
+      std::memcpy(dst, _previous.data(), _previous.size());
+      return;
+    }
+    const unsigned char *src = rgba + size_t(y - first) * _width * 4;
+    for (size_t x = 0; x < _width; x++) {
+      for (int c = 0; c < 3; c++) {
+        dst[x * 3 + c] = src[4 * x + c];
+      }
+    }
+  };
+
+  // each band is one IDAT chunk, the zlib header opening the first
+  std::vector<unsigned char> data;
+  if (first == 0)
+    data = {0x78, 0x01};
+  const bool isLast = first + rows == _height;
+  const uint32_t checksum = deflateRows(first, first + rows, size_t(_width) * 3,
+                                        3, readRow, _options, isLast, data);
+  _checksum = first == 0 ? checksum
+                         : adler32Combine(_checksum, checksum,
+                                          size_t(rows) * (_width * 3 + 1));
+  if (isLast)
+    appendBigEndian(data, _checksum);
+
+  if (rows > 0)
+    readRow(first + rows - 1, _previous.data());
+  _rowsWritten += rows;
+
+  std::vector<unsigned char> chunk;
+  appendChunk(chunk, "IDAT", data);
+  writeBytes(chunk);
+}
+
+
+void PngStream::finish() {
+  if (_rowsWritten != _height)
+    throw std::logic_error("PNG stream finished before its last row");
+
+  std::vector<unsigned char> chunk;
+  appendChunk(chunk, "IEND", {});
+  writeBytes(chunk);
+  _file.close();
+}
+
+
+void PngStream::writeBytes(const std::vector<unsigned char> &bytes) {
+  _file.write(reinterpret_cast<const char *>(bytes.data()), bytes.size());
+  if (!_file)
+    throw std::runtime_error("Could not write " + _filename + "\n");
+}
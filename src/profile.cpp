@@ -0,0 +1,321 @@
+#include "../include/counters.h"
+#include "../include/profile.h"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+
+// events kept per thread, older ones are overwritten
+const size_t kRingEvents = 1 << 16;
+
+// 8 log-linear buckets per power of two, so percentiles are within 1/16
+const size_t kBuckets = 504;
+
+
+struct ProfileEvent {
+  const char *name;
+  uint64_t start;
+  uint64_t end;
+};
+
+
+struct ScopeStats {
+  uint64_t count = 0;
+  uint64_t total = 0;
+  uint64_t longest = 0;
+  std::array<uint64_t, kBuckets> histogram{};
+};
+
+
+struct PhaseCounts {
+  uint64_t count = 0;
+  CounterValues events;
+};
+
+
+struct ThreadProfile {
+  uint32_t tid;
+  std::vector<ProfileEvent> ring;
+  size_t next = 0;
+  std::unordered_map<const char *, ScopeStats> stats;
+  std::unordered_map<const char *, PhaseCounts> phases;
+
+  // only contended while exporting
+  std::mutex mutex;
+};
+
+
+// Every thread's profile, kept after its thread exits so it can still be
+// exported. Created on the first recorded event, which also schedules the
+// statistics to be written at exit
+struct ProfileRegistry {
+  std::mutex mutex;
+  std::vector<std::unique_ptr<ThreadProfile>> threads;
+
+  // why some events were not counted, from the first thread that tried
+  std::string countersError;
+};
+
+std::atomic<bool> isCountingOn{false};
+
+
+ProfileRegistry &registry() {
+  static ProfileRegistry instance;
+  return instance;
+}
+
+
+void writeStatsAtExit() { writeProfileStats(std::cerr); }
+
+
+ThreadProfile &threadProfile() {
+  thread_local ThreadProfile *profile = nullptr;
+  if (!profile) {
+    ProfileRegistry &r = registry();
+    std::lock_guard<std::mutex> lock(r.mutex);
+    if (r.threads.empty())
+      std::atexit(writeStatsAtExit);
+    r.threads.push_back(std::make_unique<ThreadProfile>());
+    profile = r.threads.back().get();
+    profile->tid = r.threads.size();
+    profile->ring.reserve(kRingEvents);
+  }
+  return *profile;
+}
+
+
+size_t bucketOf(uint64_t ns) {
+  if (ns < 8)
+    return ns;
+  const int msb = 63 - __builtin_clzll(ns);
+  return (msb - 2) * 8 + ((ns >> (msb - 3)) & 7);
+}
+
+
+// middle of a bucket's range [ns]
+double bucketMiddle(size_t bucket) {
+  if (bucket < 8)
+    return bucket;
+  const int msb = bucket / 8 + 2;
+  const double low = double(8 + bucket % 8) * double(uint64_t(1) << (msb - 3));
+  return low + double(uint64_t(1) << (msb - 3)) / 2;
+}
+
+
+double percentile(const ScopeStats &stats, double q) {
+  const double rank = q * stats.count;
+  uint64_t seen = 0;
+  for (size_t b = 0; b < kBuckets; b++) {
+    seen += stats.histogram[b];
+    if (seen > 0 && seen >= rank)
+      return std::min(bucketMiddle(b), double(stats.longest));
+  }
+  return 0.0;
+}
+
+
+uint64_t profileClock() {
+  static const auto epoch = std::chrono::steady_clock::now();
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now() - epoch)
+      .count();
+}
+
+
+void profileRecord(const char *name, uint64_t start, uint64_t end) {
+  ThreadProfile &profile = threadProfile();
+  std::lock_guard<std::mutex> lock(profile.mutex);
+
+  if (profile.ring.size() < kRingEvents) {
+    profile.ring.push_back({name, start, end});
+  } else {
+    profile.ring[profile.next] = {name, start, end};
+  }
+  profile.next = (profile.next + 1) % kRingEvents;
+
+  ScopeStats &stats = profile.stats[name];
+  stats.count++;
+  stats.total += end - start;
+  stats.longest = std::max(stats.longest, end - start);
+  stats.histogram[bucketOf(end - start)]++;
+}
+
+
+void setProfileCounting(bool isCounting) { isCountingOn = isCounting; }
+
+
+void profileCount(const char *name, const CounterValues &events) {
+  ThreadProfile &profile = threadProfile();
+  std::lock_guard<std::mutex> lock(profile.mutex);
+  PhaseCounts &phase = profile.phases[name];
+  phase.count++;
+  phase.events += events;
+}
+
+
+CountedScope::CountedScope(const char *name)
+    : _scope(name), _name(name), _isCounting(isCountingOn) {
+  if (!_isCounting)
+    return;
+
+  const CounterGroup &group = threadCounters();
+  thread_local bool isChecked = false;
+  if (!isChecked && !group.error().empty()) {
+    ProfileRegistry &r = registry();
+    std::lock_guard<std::mutex> lock(r.mutex);
+    if (r.countersError.empty())
+      r.countersError = group.error();
+  }
+  isChecked = true;
+  _start = group.read();
+}
+
+
+CountedScope::~CountedScope() {
+  if (_isCounting)
+    profileCount(_name, threadCounters().read() - _start);
+}
+
+
+void writeTrace(const std::string &filename) {
+  std::ofstream fileStream(filename);
+  if (!fileStream)
+    throw std::runtime_error("Could not open " + filename + "\n");
+
+  fileStream << "{\"displayTimeUnit\": \"ns\", \"traceEvents\": [\n";
+  bool isFirst = true;
+  ProfileRegistry &r = registry();
+  std::lock_guard<std::mutex> registryLock(r.mutex);
+  for (const auto &profile : r.threads) {
+    std::lock_guard<std::mutex> lock(profile->mutex);
+    // oldest first, once the ring has wrapped it starts at the next slot
+    const size_t size = profile->ring.size();
+    for (size_t k = 0; k < size; k++) {
+      const ProfileEvent &event =
+          profile->ring[size < kRingEvents ? k : (profile->next + k) % size];
+      fileStream << (isFirst ? "" : ",\n") << std::fixed
+                 << std::setprecision(3) << "{\"name\": \"" << event.name
+                 << "\", \"ph\": \"X\", \"pid\": 1, \"tid\": " << profile->tid
+                 << ", \"ts\": " << event.start / 1000.0
+                 << ", \"dur\": " << (event.end - event.start) / 1000.0 << '}';
+      isFirst = false;
+    }
+  }
+  fileStream << "\n]}\n";
+  if (!fileStream)
+    throw std::runtime_error("Could not write " + filename + "\n");
+}
+
+
+void writeProfileStats(std::ostream &out) {
+  std::map<std::string, ScopeStats> merged;
+  std::map<std::string, PhaseCounts> phases;
+  std::string countersError;
+  {
+    ProfileRegistry &r = registry();
+    std::lock_guard<std::mutex> registryLock(r.mutex);
+    countersError = r.countersError;
+    for (const auto &profile : r.threads) {
+      std::lock_guard<std::mutex> lock(profile->mutex);
+      for (const auto &entry : profile->phases) {
+        PhaseCounts &total = phases[entry.first];
+        total.count += entry.second.count;
+        total.events += entry.second.events;
+      }
+      for (const auto &entry : profile->stats) {
+        ScopeStats &total = merged[entry.first];
+        total.count += entry.second.count;
+        total.total += entry.second.total;
+        total.longest = std::max(total.longest, entry.second.longest);
+        for (size_t b = 0; b < kBuckets; b++) {
+          total.histogram[b] += entry.second.histogram[b];
+        }
+      }
+    }
+  }
+  if (merged.empty())
+    return;
+
+  std::vector<std::pair<std::string, ScopeStats>> scopes(merged.begin(),
+                                                         merged.end());
+  std::sort(scopes.begin(), scopes.end(), [](const auto &a, const auto &b) {
+    return a.second.total > b.second.total;
+  });
+
+  out << std::left << std::setw(24) << "scope" << std::right << std::setw(12)
+      << "count" << std::setw(14) << "total ms" << std::setw(12) << "p50 us"
+      << std::setw(12) << "p99 us" << '\n';
+  for (const auto &scope : scopes) {
+    const ScopeStats &s = scope.second;
+    out << std::left << std::setw(24) << scope.first << std::right
+        << std::setw(12) << s.count << std::fixed << std::setprecision(3)
+        << std::setw(14) << s.total / 1e6 << std::setw(12)
+        << percentile(s, 0.5) / 1e3 << std::setw(12)
+        << percentile(s, 0.99) / 1e3 << std::defaultfloat << '\n';
+  }
+
+  if (phases.empty())
+    return;
+  if (!countersError.empty())
+    out << "\ncounters: " << countersError << '\n';
+
+  // events per call, and their ratios, "-" where not counted
+  auto column = [&out](double value, int width, int precision) {
+    out << std::setw(width);
+    if (std::isnan(value)) {
+      out << '-';
+    } else {
+      out << std::fixed << std::setprecision(precision) << value
+          << std::defaultfloat;
+    }
+  };
+  auto perCall = [](const PhaseCounts &phase, CounterEvent event) {
+    return phase.events.has(event)
+               ? double(phase.events[event]) / phase.count
+               : std::nan("");
+  };
+
+  out << '\n' << std::left << std::setw(24) << "counted scope" << std::right
+      << std::setw(12) << "count" << std::setw(14) << "cycles/call"
+      << std::setw(14) << "instr/call" << std::setw(8) << "IPC"
+      << std::setw(14) << "cache miss %" << std::setw(15) << "branch miss %"
+      << std::setw(14) << "task us/call" << std::setw(12) << "faults"
+      << '\n';
+  for (const auto &entry : phases) {
+    const PhaseCounts &p = entry.second;
+    out << std::left << std::setw(24) << entry.first << std::right
+        << std::setw(12) << p.count;
+    column(perCall(p, CounterEvent::Cycles), 14, 0);
+    column(perCall(p, CounterEvent::Instructions), 14, 0);
+    column(counterRatio(p.events, CounterEvent::Instructions,
+                        CounterEvent::Cycles),
+           8, 2);
+    column(100 * counterRatio(p.events, CounterEvent::CacheMisses,
+                              CounterEvent::CacheReferences),
+           14, 2);
+    column(100 * counterRatio(p.events, CounterEvent::BranchMisses,
+                              CounterEvent::Branches),
+           15, 2);
+    column(perCall(p, CounterEvent::TaskClock) / 1e3, 14, 3);
+    column(p.events.has(CounterEvent::PageFaults)
+               ? double(p.events[CounterEvent::PageFaults])
+               : std::nan(""),
+           12, 0);
+    out << '\n';
+  }
+}
@@ -0,0 +1,193 @@
+#include "../include/server.h"
+#include "../include/date.h"
+#include "../include/ephemeris.h"
+#include "../include/frame.h"
+#include "../include/io.h"
+#include "../include/threadPool.h"
+#include "../include/util.h"
+
+#include <exception>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifndef _WIN32
+#include <csignal>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+
+// returns days since J2000 epoch of a MM/DD/YYYY or JD<julian day> argument
+double parseEpoch(const std::string &epoch) {
+  if (epoch.rfind("JD", 0) == 0)
+    return std::stod(epoch.substr(2)) - JD_EPOCH;
+
+  Date date;
+  if (!parseDate(epoch, date))
+    throw std::invalid_argument("expected MM/DD/YYYY or JD<julian day>");
+  return date.calcDaysSinceEpoch();
+}
+
+
+// answers a single request line
+std::string handleRequest(Ephemeris &ephemeris, const std::string &request) {
+  std::istringstream fields(request);
+  std::string id, mode, epoch, frame;
+  fields >> id >> mode >> epoch >> frame;
+
+  std::ostringstream response;
+  response << id;
+
+  try {
+    if (mode == "stats") {
+      response << " OK checkpoints " << ephemeris.checkpointCount();
+      return response.str();
+    }
+
+    if (mode != "kepler" && mode != "nbody")
+      throw std::invalid_argument("unknown mode \"" + mode + "\"");
+
+    const double daysSinceEpoch = parseEpoch(epoch);
+    std::vector<StateVector> bodies =
+        mode == "kepler" ? ephemeris.keplerian(daysSinceEpoch)
+                         : ephemeris.nBody(daysSinceEpoch);
+    toFrame(bodies, frame.empty() ? Frame::Heliocentric : parseFrame(frame));
+
+    response << " OK " << std::fixed << std::setprecision(5)
+             << daysSinceEpoch + JD_EPOCH << std::scientific
+             << std::setprecision(15);
+    for (const StateVector &b : bodies) {
+      response << ' ' << bodyName(b.id) << ':' << b.pos.x << ',' << b.pos.y
+               << ',' << b.pos.z << ',' << b.vel.x << ',' << b.vel.y << ','
+               << b.vel.z;
+    }
+  } catch (const std::exception &e) {
+    response.str("");
+    response << id << " ERR " << e.what();
+  }
+
+  return response.str();
+}
+
+
+// answers requests from stdin on the pool until end of input
+void serveStream(Ephemeris &ephemeris, ThreadPool &pool) {
+  std::mutex outputMutex;
+  std::string line;
+
+  while (std::getline(std::cin, line)) {
+    if (line.find_first_not_of(" \t\r") == std::string::npos)
+      continue;
+
+    pool.submit([&ephemeris, &outputMutex, line] {
+      const std::string response = handleRequest(ephemeris, line);
+      std::lock_guard<std::mutex> lock(outputMutex);
+      std::cout << response << std::endl;
+    });
+  }
+
+  pool.wait();
+}
+
+
+#ifndef _WIN32
+
+// A connected client. Closed once the reader and every pending response are
+// done with it
+struct Connection {
+  explicit Connection(int fd) : fd(fd) {}
+  ~Connection() { close(fd); }
+
+  void send(const std::string &response) {
+    std::lock_guard<std::mutex> lock(writeMutex);
+    const std::string line = response + '\n';
+    size_t sent = 0;
+    while (sent < line.size()) {
+      const ssize_t n = write(fd, line.data() + sent, line.size() - sent);
+      if (n <= 0)
+        return;
+      sent += n;
+    }
+  }
+
+  const int fd;
+  std::mutex writeMutex;
+};
+
+
+// splits a client's byte stream into request lines and queues each of them
+void readRequests(Ephemeris &ephemeris, ThreadPool &pool,
+                  std::shared_ptr<Connection> connection) {
+  std::string buffer;
+  char chunk[4096];
+  ssize_t n;
+
+  while ((n = read(connection->fd, chunk, sizeof(chunk))) > 0) {
+    buffer.append(chunk, n);
+
+    size_t lineEnd;
+    while ((lineEnd = buffer.find('\n')) != std::string::npos) {
+      const std::string line = buffer.substr(0, lineEnd);
+      buffer.erase(0, lineEnd + 1);
+
+      if (line.find_first_not_of(" \t\r") == std::string::npos)
+        continue;
+
+      pool.submit([&ephemeris, connection, line] {
+        connection->send(handleRequest(ephemeris, line));
+      });
+    }
+  }
+}
+
+
+// answers requests from every client of a Unix domain socket at path
+void serveSocket(Ephemeris &ephemeris, ThreadPool &pool,
+                 const std::string &path) {
+  sockaddr_un address = {};
+  address.sun_family = AF_UNIX;
+  if (path.size() >= sizeof(address.sun_path))
+    throw std::invalid_argument("Socket path too long: " + path);
+  path.copy(address.sun_path, path.size());
+
+  const int listener = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (listener < 0)
+    throw std::runtime_error("Could not create socket");
+
+  // clients that disconnect early must not terminate the server
+  std::signal(SIGPIPE, SIG_IGN);
+
+  unlink(path.c_str());
+  if (bind(listener, reinterpret_cast<sockaddr *>(&address), sizeof(address)) <
+          0 ||
+      listen(listener, SOMAXCONN) < 0) {
+    close(listener);
+    throw std::runtime_error("Could not listen on " + path);
+  }
+
+  int fd;
+  while ((fd = accept(listener, nullptr, nullptr)) >= 0) {
+    std::thread(readRequests, std::ref(ephemeris), std::ref(pool),
+                std::make_shared<Connection>(fd))
+        .detach();
+  }
+
+  close(listener);
+  unlink(path.c_str());
+}
+
+#else
+
+void serveSocket(Ephemeris &, ThreadPool &, const std::string &) {
+  throw std::runtime_error("Unix domain sockets are not supported here");
+}
+
+#endif
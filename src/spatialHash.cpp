@@ -0,0 +1,77 @@
+#include "../include/spatialHash.h"
+#include "../include/planet.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <functional>
+#include <utility>
+#include <vector>
+
+
+// hash of a cell, collisions only cost extra distance checks
+int64_t cellKey(int64_t x, int64_t y, int64_t z) {
+  return x * 73856093 ^ y * 19349663 ^ z * 83492791;
+}
+
+
+int64_t SpatialHash::cellOf(double x) const {
+  return static_cast<int64_t>(std::floor(x / _cellSize));
+}
+
+
+void SpatialHash::build(const std::vector<StateVector> &bodies,
+                        double cellSize) {
+  _cellSize = cellSize;
+  _cells.clear();
+  if (cellSize <= 0.0)
+    return;
+
+  for (size_t i = 0; i < bodies.size(); i++) {
+    const Coord &p = bodies[i].pos;
+    _cells.emplace_back(cellKey(cellOf(p.x), cellOf(p.y), cellOf(p.z)), i);
+  }
+  std::sort(_cells.begin(), _cells.end());
+}
+
+
+void SpatialHash::findPairs(
+    const std::vector<StateVector> &bodies,
+    const std::function<double(size_t, size_t)> &reach,
+    std::vector<std::pair<size_t, size_t>> &pairs) const {
+  pairs.clear();
+
+  auto byKey = [](const std::pair<int64_t, size_t> &a,
+                  const std::pair<int64_t, size_t> &b) {
+    return a.first < b.first;
+  };
+
+  for (const auto &cell : _cells) {
+    const size_t i = cell.second;
+    const Coord &p = bodies[i].pos;
+    const int64_t x = cellOf(p.x), y = cellOf(p.y), z = cellOf(p.z);
+
+    // every close pair lies in the same or a neighbouring cell
+    for (int64_t dx = -1; dx <= 1; dx++)
+      for (int64_t dy = -1; dy <= 1; dy++)
+        for (int64_t dz = -1; dz <= 1; dz++) {
+          const auto range = std::equal_range(
+              _cells.begin(), _cells.end(),
+              std::make_pair(cellKey(x + dx, y + dy, z + dz), size_t(0)),
+              byKey);
+
+          for (auto it = range.first; it != range.second; it++) {
+            const size_t j = it->second;
+            if (j <= i)
+              continue;
+            const double distance = reach(i, j);
+            if (p.magSquared(bodies[j].pos) < distance * distance)
+              pairs.emplace_back(i, j);
+          }
+        }
+  }
+
+  // hash collisions can report a pair twice
+  std::sort(pairs.begin(), pairs.end());
+  pairs.erase(std::unique(pairs.begin(), pairs.end()), pairs.end());
+}
@@ -0,0 +1,68 @@
+#include "../include/threadPool.h"
+
+#include <algorithm>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <utility>
+
+ThreadPool::ThreadPool(unsigned threadCount) {
+  threadCount = std::max(1u, threadCount);
+  for (unsigned i = 0; i < threadCount; i++) {
+    _workers.emplace_back(&ThreadPool::work, this);
+  }
+}
+
+ThreadPool::~ThreadPool() {
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    _stopping = true;
+  }
+  _taskReady.notify_all();
+
+  for (std::thread &worker : _workers) {
+    worker.join();
+  }
+}
+
+void ThreadPool::submit(std::function<void()> task) {
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    _tasks.push(std::move(task));
+  }
+  _taskReady.notify_one();
+}
+
+void ThreadPool::wait() {
+  std::unique_lock<std::mutex> lock(_mutex);
+  _idle.wait(lock, [this] { return _tasks.empty() && _running == 0; });
+}
+
+/**
+   Runs queued tasks until the pool is stopped and the queue is drained.
+ */
+void ThreadPool::work() {
+  while (true) {
+    std::function<void()> task;
+    {
+      std::unique_lock<std::mutex> lock(_mutex);
+      _taskReady.wait(lock, [this] { return _stopping || !_tasks.empty(); });
+
+      if (_tasks.empty())
+        return;
+
+      task = std::move(_tasks.front());
+      _tasks.pop();
+      _running++;
+    }
+
+    task();
+
+    {
+      std::lock_guard<std::mutex> lock(_mutex);
+      _running--;
+      if (_tasks.empty() && _running == 0)
+        _idle.notify_all();
+    }
+  }
+}
@@ -0,0 +1,98 @@
+#include "../include/camera.h"
+#include "../include/picture.h"
+#include "../include/planet.h"
+#include "../include/png.h"
+#include "../include/profile.h"
+#include "../include/tiles.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+
+PathMask::PathMask(const Camera &camera)
+    : _camera(camera), _wordsPerRow((size_t(camera.size()) + 63) / 64),
+      _bits(new std::atomic<uint64_t>[_wordsPerRow * camera.size()]) {
+  for (size_t k = 0; k < _wordsPerRow * camera.size(); k++) {
+    _bits[k].store(0, std::memory_order_relaxed);
+  }
+}
+
+
+// Marks the pixel of every body. Safe to call from several threads at once
+void PathMask::mark(const std::vector<StateVector> &bodies) {
+  Point p;
+  for (const StateVector &b : bodies) {
+    if (!_camera.project(b.pos, p))
+      continue;
+    _bits[size_t(p.y) * _wordsPerRow + p.x / 64].fetch_or(
+        uint64_t(1) << (p.x % 64), std::memory_order_relaxed);
+  }
+}
+
+
+// sets every marked pixel of a tile to color, skipping empty words
+void PathMask::draw(Picture &tile, const Camera &window,
+                    rgbColor color) const {
+  const int x0 = window.windowX();
+  const int y0 = window.windowY();
+  const int x1 = std::min(_camera.size(), x0 + tile.width());
+  const int y1 = std::min(_camera.size(), y0 + tile.height());
+
+  std::vector<Point> points;
+  for (int y = std::max(0, y0); y < y1; y++) {
+    const std::atomic<uint64_t> *row = &_bits[size_t(y) * _wordsPerRow];
+    for (int word = std::max(0, x0) / 64; word * 64 < x1; word++) {
+      uint64_t bits = row[word].load(std::memory_order_relaxed);
+      while (bits) {
+        const int x = word * 64 + __builtin_ctzll(bits);
+        bits &= bits - 1;
+        if (x >= x0 && x < x1)
+          points.push_back({x - x0, y - y0});
+      }
+    }
+  }
+  tile.plot(points, color);
+}
+
+
+// Renders a square canvas in bands of rows, streaming each band into a PNG
+void renderTiles(const std::string &filename, const Camera &camera,
+                 int tileRows, rgbColor background,
+                 const std::function<void(Picture &, const Camera &)> &draw,
+                 const PngOptions &options) {
+  if (tileRows < 1)
+    throw std::invalid_argument("Tiles need at least one row");
+
+  const int size = camera.size();
+  PngStream png(filename, size, size, options);
+
+  // every band starts as a copy of this
+  Picture blank(size, std::min(tileRows, size), background);
+  blank.setFixed(true);
+  Picture tile;
+
+  for (int top = 0; top < size; top += tileRows) {
+    PROFILE_SCOPE("tiles.band");
+    const int rows = std::min(tileRows, size - top);
+    if (rows < blank.height()) {
+      blank = Picture(size, rows, background);
+      blank.setFixed(true);
+    }
+    tile = blank;
+
+    Camera window = camera;
+    window.setWindow(0, top, size, rows);
+    draw(tile, window);
+
+    // drawing may have switched the band to indices
+    tile.setIndexed(false);
+    png.write(reinterpret_cast<const unsigned char *>(tile.row(0)), rows);
+  }
+  png.finish();
+}
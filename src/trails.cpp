@@ -0,0 +1,132 @@
+#include "../include/camera.h"
+#include "../include/nBodyApprox.h"
+#include "../include/picture.h"
+#include "../include/planet.h"
+#include "../include/profile.h"
+#include "../include/trails.h"
+
+#include <cmath>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+
+TrailRenderer::TrailRenderer(Picture &pic, const Camera &camera,
+                             rgbColor color, double spacing)
+    : _pic(pic), _camera(camera), _color(color),
+      _spacingSquared(spacing * spacing) {}
+
+
+// the calling thread's samples, created on its first use
+std::vector<TrailRenderer::Sample> &TrailRenderer::samples() {
+  std::lock_guard<std::mutex> lock(_samplesMutex);
+  return _samples[std::this_thread::get_id()];
+}
+
+
+void TrailRenderer::observe(const std::vector<StateVector> &bodies) {
+  PROFILE_SCOPE("trails.observe");
+  std::vector<Sample> &last = samples();
+
+  // reused between calls, drawing runs inside the integration loop
+  thread_local std::vector<Point> points;
+  thread_local std::vector<float> coverage;
+  points.clear();
+  coverage.clear();
+
+  for (const StateVector &b : bodies) {
+    if (b.id >= last.size())
+      last.resize(b.id + 1);
+    Sample &sample = last[b.id];
+
+    // a trail leaving the window restarts where it comes back
+    double x, y;
+    if (!_camera.project(b.pos, x, y, 1)) {
+      sample.isSet = false;
+      continue;
+    }
+
+    if (sample.isSet) {
+      const double dx = x - sample.x;
+      const double dy = y - sample.y;
+      if (dx * dx + dy * dy < _spacingSquared)
+        continue;
+      wuLine(sample.x, sample.y, x, y, points, coverage);
+    }
+    sample = {x, y, true};
+  }
+
+  if (points.empty())
+    return;
+  std::lock_guard<std::mutex> lock(_picMutex);
+  _pic.blend(points, coverage, _color);
+}
+
+
+StepObserver TrailRenderer::observer() {
+  return [this](const std::vector<StateVector> &bodies) { observe(bodies); };
+}
+
+
+// fractional part of x
+double fpart(double x) { return x - std::floor(x); }
+
+
+// Appends the pixels of an anti-aliased line between two points in window
+// coordinates. Steps along the major axis, splitting each step's coverage
+// between the two pixels straddling the line. Endpoints are weighted by how
+// much of their pixel the line reaches into, so segments sharing an endpoint
+// add up to one full pixel there
+void wuLine(double x0, double y0, double x1, double y1,
+            std::vector<Point> &points, std::vector<float> &coverage) {
+  // pixel centers on whole coordinates
+  x0 -= 0.5;
+  y0 -= 0.5;
+  x1 -= 0.5;
+  y1 -= 0.5;
+
+  const bool isSteep = std::abs(y1 - y0) > std::abs(x1 - x0);
+  if (isSteep) {
+    std::swap(x0, y0);
+    std::swap(x1, y1);
+  }
+  if (x0 > x1) {
+    std::swap(x0, x1);
+    std::swap(y0, y1);
+  }
+
+  const double dx = x1 - x0;
+  const double gradient = dx == 0.0 ? 1.0 : (y1 - y0) / dx;
+
+  auto plot = [&](int major, int minor, double c) {
+    if (c <= 0.0)
+      return;
+    points.push_back(isSteep ? Point{minor, major} : Point{major, minor});
+    coverage.push_back(float(c));
+  };
+
+  // first endpoint
+  double xEnd = std::round(x0);
+  double yEnd = y0 + gradient * (xEnd - x0);
+  double xGap = 1.0 - fpart(x0 + 0.5);
+  const int first = int(xEnd);
+  plot(first, int(std::floor(yEnd)), (1.0 - fpart(yEnd)) * xGap);
+  plot(first, int(std::floor(yEnd)) + 1, fpart(yEnd) * xGap);
+  double yAt = yEnd + gradient;
+
+  // second endpoint
+  xEnd = std::round(x1);
+  yEnd = y1 + gradient * (xEnd - x1);
+  xGap = fpart(x1 + 0.5);
+  const int last = int(xEnd);
+  plot(last, int(std::floor(yEnd)), (1.0 - fpart(yEnd)) * xGap);
+  plot(last, int(std::floor(yEnd)) + 1, fpart(yEnd) * xGap);
+
+  for (int x = first + 1; x < last; x++) {
+    const int y = int(std::floor(yAt));
+    plot(x, y, 1.0 - fpart(yAt));
+    plot(x, y + 1, fpart(yAt));
+    yAt += gradient;
+  }
+}